@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+#
+#  closures.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Measures the throughput of closure creation, with environments allocated
+on the stack, on the heap, or with nested functions lambda lifted.
+
+A module is generated by gen_ast.py, where each global function declares a
+chain of `--depth` nested functions, each capturing `--captures` values of
+the function declaring it. Calling the last global function thus creates
+`--functions` times `--depth` closures. The module is compiled to an object
+in each mode, linked with the runtime in a shared library, and its last
+function is called repeatedly by a driver, which reports the time it took
+and the memory the runtime allocated meanwhile. With --json, the results are
+also written to a file.
+
+The modes are:
+
+* `lifted`: the default, where nested functions are lambda lifted, and no
+  closure is created at all;
+* `stack`: with --no-lift, where environments are allocated on the stack;
+* `heap`: with --no-lift --escaping-closures, where environments and the
+  mutable values they capture are allocated by the runtime.
+
+Heap environments are never freed, as there is no garbage collector, so the
+memory of the heap mode grows with the number of iterations, by the size of
+the environments and boxes of each call. That growth is reported along with
+the time, which doesn't account for it.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+MODES = {
+    'lifted': [],
+    'stack':  ['--no-lift'],
+    'heap':   ['--no-lift', '--escaping-closures'],
+}
+
+DRIVER = r'''
+#include <dlfcn.h>
+#include <time.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char* argv[]) {
+    void* library = dlopen(argv[1], RTLD_NOW);
+    if (library == nullptr) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        return 1;
+    }
+    auto function   = reinterpret_cast<long (*)(long)>(dlsym(library, argv[2]));
+    auto heap_size  = reinterpret_cast<std::uint64_t (*)()>(dlsym(library, "tango_heap_size"));
+    long iterations = std::atol(argv[3]);
+
+    timespec start, end;
+    long     sum = 0;
+    auto start_heap_size = heap_size();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; ++i) {
+        sum += function(i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    auto heap_growth = heap_size() - start_heap_size;
+
+    double seconds = double(end.tv_sec - start.tv_sec) + double(end.tv_nsec - start.tv_nsec) * 1e-9;
+    std::printf("%.9f %ld %llu\n", seconds, sum, static_cast<unsigned long long>(heap_growth));
+    return 0;
+}
+'''
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('tango', help='path to the tango binary')
+    parser.add_argument('--functions', type=int, default=100)
+    parser.add_argument('--depth', type=int, default=3)
+    parser.add_argument('--captures', type=int, default=2)
+    parser.add_argument('--iterations', type=int, default=2000)
+    parser.add_argument('--repeat', type=int, default=3)
+    parser.add_argument('--opt-level', default='2', choices=['0', '1', '2', '3', 's'])
+    parser.add_argument('--cxx', default=os.environ.get('CXX', 'c++'),
+                        help='C++ compiler used to build the runtime and the driver')
+    parser.add_argument('--json', help='file to which the results are written')
+    args = parser.parse_args()
+
+    root      = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    generator = os.path.join(root, 'bench', 'gen_ast.py')
+    closures  = args.iterations * args.functions * args.depth
+    results   = []
+
+    with tempfile.TemporaryDirectory() as workdir:
+        source  = os.path.join(workdir, 'input.ast')
+        runtime = os.path.join(workdir, 'runtime.o')
+        driver  = os.path.join(workdir, 'driver')
+        subprocess.check_call([sys.executable, generator,
+                               '--functions', str(args.functions),
+                               '--depth', str(args.depth),
+                               '--captures', str(args.captures), source])
+
+        with open(driver + '.cc', 'w') as f:
+            f.write(DRIVER)
+        subprocess.check_call([args.cxx, '-O2', '-o', driver, driver + '.cc', '-ldl'])
+        subprocess.check_call([args.cxx, '-O2', '-fPIC', '-c', '-o', runtime,
+                               os.path.join(root, 'tango', 'runtime.cc')])
+
+        print('%-8s %10s %14s %10s %10s' % ('mode', 'seconds', 'closures/s', 'ns/closure', 'heap MB'))
+        for mode in ['lifted', 'stack', 'heap']:
+            module  = os.path.join(workdir, mode + '.o')
+            library = os.path.join(workdir, 'lib%s.so' % mode)
+            subprocess.check_call([args.tango, '-O%s' % args.opt_level] + MODES[mode]
+                                  + ['-o', module, source])
+            subprocess.check_call([args.cxx, '-shared', '-o', library, module, runtime])
+
+            # Keep the best of several runs, to filter out noise. The heap
+            # growth, in bytes, is the same for every run.
+            best = None
+            for _ in range(args.repeat):
+                output = subprocess.check_output(
+                    [driver, library, 'f%d' % (args.functions - 1), str(args.iterations)]).split()
+                seconds     = max(float(output[0]), 1e-9)
+                heap_growth = int(output[2])
+                best        = seconds if best is None else min(best, seconds)
+
+            print('%-8s %10.4f %14.0f %10.2f %10.1f' % (
+                mode, best, closures / best, best * 1e9 / closures, heap_growth / 1048576.0))
+            results.append({'mode': mode, 'closures': closures, 'seconds': best,
+                            'closures_per_second': closures / best, 'heap_bytes': heap_growth})
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'functions': args.functions, 'depth': args.depth,
+                       'captures': args.captures, 'opt_level': args.opt_level,
+                       'results': results}, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
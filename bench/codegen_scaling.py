@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+#
+#  codegen_scaling.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Measures the wall time of the compilation of a synthetic module with 1,
+2, 4, 8 and 16 threads, and checks that the generated code doesn't depend on
+the number of threads.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('tango', help='path to the tango binary')
+    parser.add_argument('--functions', type=int, default=20000)
+    parser.add_argument('--repeat', type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as workdir:
+        source = os.path.join(workdir, 'input.ast')
+        generator = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'gen_ast.py')
+        subprocess.check_call([sys.executable, generator, '--functions', str(args.functions), source])
+
+        print('%8s %10s %8s' % ('threads', 'seconds', 'speedup'))
+        baseline = None
+        reference = None
+        for threads in [1, 2, 4, 8, 16]:
+            # Keep the best of several runs, to filter out noise.
+            best = None
+            for _ in range(args.repeat):
+                start = time.perf_counter()
+                output = subprocess.check_output([args.tango, '-j', str(threads), source])
+                elapsed = time.perf_counter() - start
+                best = elapsed if best is None else min(best, elapsed)
+
+            if baseline is None:
+                baseline = best
+                reference = output
+            print('%8d %10.3f %8.2f' % (threads, best, baseline / best))
+
+            if output != reference:
+                print('error: the output with %d threads differs from the output with 1 thread'
+                      % threads, file=sys.stderr)
+                return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+#
+#  gen_ast.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Generates synthetic Tango ASTs, in the JSON schema read by the compiler.
+
+The module declares `--functions` global functions `f0`, ..., `fN`, where
+each function forwards its argument to the previous one, and calls the last
+function from its top-level code, so that all functions are reachable.
+Binary expressions aren't emitted, as the IR generator doesn't support them
+yet.
+
+The shape of each function is controlled by:
+
+* `--depth`: the number of nested functions declared within each other in
+  every global function, each called by the function that declares it;
+* `--captures`: the number of local properties that each function declares
+  for its nested function, which reads all of them;
+* `--width`: the number of extra properties that each function declares and
+  assigns;
+* `--calls`: the number of calls that each function makes to its nested
+  function, or to the previous global function for the innermost ones.
+"""
+
+import argparse
+import json
+import sys
+
+
+INT = 'Int'
+
+
+def meta(type=None, **kwargs):
+    ret = {'start': [1, 1], 'end': [1, 1], 'scope': 'main'}
+    if type is not None:
+        ret['type'] = type
+    ret.update(kwargs)
+    return ret
+
+
+def identifier(name, type):
+    return {'Identifier': {'__meta__': meta(type, mutability='cst'), 'name': name}}
+
+
+def literal(value):
+    return {'Literal': {'__meta__': meta(INT), 'value': str(value)}}
+
+
+def call(callee, argument, label='x'):
+    fun = '(cst %s: Int) -> Int' % label
+    return {'Call': {
+        '__meta__': meta(INT, function_call_type=fun),
+        'callee': identifier(callee, fun),
+        'arguments': [{'CallArgument': {
+            '__meta__': meta(), 'label': label, 'operator': '=', 'value': argument}}]}}
+
+
+def block(statements):
+    return {'Block': {'__meta__': meta(), 'statements': statements}}
+
+
+def property_decl(name):
+    return {'PropertyDecl': {'__meta__': meta(INT), 'mutability': 'cst', 'name': name}}
+
+
+def assignment(name, value):
+    return {'Assignment': {
+        '__meta__': meta(), 'lvalue': identifier(name, INT), 'operator': '=', 'rvalue': value}}
+
+
+def local(name, value):
+    """Declares a property and assigns it a value."""
+    return [property_decl(name), assignment(name, value)]
+
+
+def function_decl(name, parameter, statements):
+    return {'FunctionDecl': {
+        '__meta__': meta('(cst %s: Int) -> Int' % parameter),
+        'name': name,
+        'parameter': {'FunctionParameter': {
+            '__meta__': meta(INT), 'mutability': 'cst', 'name': parameter,
+            'type_annotation': identifier('Int', INT)}},
+        'return_type': identifier('Int', INT),
+        'body': block(statements)}}
+
+
+def function_body(args, index, level, parameter, captured):
+    """Returns the statements of the function at the given nesting level of
+    the global function `index`, which reads the captured properties of the
+    function that declares it.
+    """
+    x = identifier(parameter, INT)
+    statements = []
+
+    # Declare the properties captured by the nested function, and the nested
+    # function itself.
+    nested = None
+    if level < args.depth:
+        nested = 'g%d' % (level + 1)
+        names = ['v%d_%d' % (level, i) for i in range(args.captures)]
+        for name in names:
+            statements += local(name, x)
+        statements.append(function_decl(
+            nested, 'y', function_body(args, index, level + 1, 'y', names)))
+
+    for i, name in enumerate(captured):
+        statements += local('r%d_%d' % (level, i), identifier(name, INT))
+    for i in range(args.width):
+        statements += local('t%d_%d' % (level, i), x)
+
+    for i in range(args.calls):
+        if nested is not None:
+            statements += local('c%d_%d' % (level, i), call(nested, x, 'y'))
+        elif index > 0:
+            statements += local('c%d_%d' % (level, i), call('f%d' % (index - 1), x))
+
+    # Functions return the result of their nested function, and innermost
+    # ones that of the previous global function, so that all functions are
+    # reachable.
+    if nested is not None:
+        value = call(nested, x, 'y')
+    elif index > 0:
+        value = call('f%d' % (index - 1), x)
+    else:
+        value = x
+    statements.append({'Return': {'__meta__': meta(), 'value': value}})
+    return statements
+
+
+def function(args, index):
+    return function_decl('f%d' % index, 'x', function_body(args, index, 0, 'x', []))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--functions', type=int, default=1000)
+    parser.add_argument('--depth', type=int, default=0)
+    parser.add_argument('--captures', type=int, default=0)
+    parser.add_argument('--width', type=int, default=0)
+    parser.add_argument('--calls', type=int, default=0)
+    parser.add_argument('output', nargs='?')
+    args = parser.parse_args()
+
+    statements = [function(args, i) for i in range(args.functions)]
+    if args.functions > 0:
+        statements.append(call('f%d' % (args.functions - 1), literal(args.functions)))
+
+    module = {'ModuleDecl': {'__meta__': {}, 'name': 'main', 'body': block(statements)}}
+    with (open(args.output, 'w') if args.output else sys.stdout) as f:
+        json.dump(module, f)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+#
+#  memory.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Measures the memory used to load modules of increasing sizes, and the
+time it takes to release their ASTs.
+
+Modules of `--functions` times each of the `--scale` factors global functions
+are generated by gen_ast.py, with `--width` properties per function, then
+compiled with --flat, --mem-report and --time-report. For the read phase,
+the size of the input is reported along with the number of allocations the
+loader made, the bytes of the AST arena and the number of its slabs, the
+peak of the live heap bytes, and the peak resident set size of the process,
+which includes the mapped input. The wall time of the release phase, where
+the AST is torn down once it has been flattened, is reported as well. With
+--json, the results are also written to a file.
+
+As the loader builds nodes while it reads the input, without materializing a
+JSON document, its peak heap is about the size of the AST, whatever the size
+of the input. As nodes are placed in the slabs of an arena, they're released
+without being visited, so teardown takes about as many frees as there are
+slabs.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+MB = 1024.0 * 1024.0
+
+
+def get_category(phase, name):
+    return next(category for category in phase['categories'] if category['name'] == name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('tango', help='path to the tango binary')
+    parser.add_argument('--functions', type=int, default=2500)
+    parser.add_argument('--scale', type=int, action='append',
+                        help='factor of the number of functions (1, 2, 4 and 8 by default)')
+    parser.add_argument('--width', type=int, default=8)
+    parser.add_argument('--json', help='file to which the results are written')
+    args = parser.parse_args()
+
+    results   = []
+    generator = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'gen_ast.py')
+    print('%9s %10s %10s %12s %6s %10s %10s %10s %12s' % (
+        'functions', 'input MB', 'AST MB', 'allocations', 'slabs', 'heap MB', 'RSS MB',
+        'heap/AST', 'teardown ms'))
+
+    with tempfile.TemporaryDirectory() as workdir:
+        source = os.path.join(workdir, 'input.ast')
+        report = os.path.join(workdir, 'report.json')
+        times  = os.path.join(workdir, 'times.json')
+        for scale in (args.scale or [1, 2, 4, 8]):
+            functions = args.functions * scale
+            subprocess.check_call([sys.executable, generator,
+                                   '--functions', str(functions),
+                                   '--width', str(args.width), source])
+            size = os.path.getsize(source)
+
+            subprocess.check_call([args.tango, '-O0', '--flat', '--mem-report=%s' % report,
+                                   '--time-report=%s' % times, '-o', os.devnull, source],
+                                  stderr=subprocess.DEVNULL)
+            with open(report) as f:
+                read = next(phase for phase in json.load(f)['phases'] if phase['name'] == 'read')
+            with open(times) as f:
+                teardown = next(phase['wall_seconds'] for phase in json.load(f)['phases']
+                                if phase['name'] == 'release')
+            total = get_category(read, 'total')
+            ast   = get_category(read, 'ast')
+
+            print('%9d %10.2f %10.2f %12d %6d %10.2f %10.2f %10.2f %12.3f' % (
+                functions, size / MB, ast['live_bytes'] / MB, total['allocations'], ast['allocations'],
+                total['peak_live_bytes'] / MB, read['peak_rss_bytes'] / MB,
+                total['peak_live_bytes'] / max(ast['live_bytes'], 1), teardown * 1e3))
+            results.append({
+                'functions': functions, 'bytes': size, 'ast_bytes': ast['live_bytes'],
+                'allocations': total['allocations'], 'ast_allocations': ast['allocations'],
+                'peak_heap_bytes': total['peak_live_bytes'],
+                'peak_rss_bytes': read['peak_rss_bytes'], 'teardown_seconds': teardown})
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'functions': args.functions, 'width': args.width,
+                       'results': results}, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+#
+#  throughput.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Measures the throughput of the phases of the compiler on synthetic
+modules of various shapes.
+
+Each scenario is generated by gen_ast.py, then compiled with --time-report,
+keeping the best of several runs. The wall time of the read, IR generation
+(including verification) and optimization phases is reported along with
+the number of AST nodes and of input bytes each phase processes per second.
+With --json, the results are also written to a file, so that throughput can
+be tracked over time.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+# Arguments of gen_ast.py for each scenario, in addition to --functions.
+SCENARIOS = {
+    'chain':    [],
+    'wide':     ['--width', '16'],
+    'calls':    ['--calls', '8'],
+    'nested':   ['--depth', '3', '--calls', '2'],
+    'captures': ['--depth', '3', '--captures', '8', '--width', '8'],
+}
+
+# Phases of the time report that make up each measured phase.
+PHASES = {
+    'read':     ['read'],
+    'irgen':    ['irgen', 'verify'],
+    'optimize': ['optimize'],
+}
+
+
+def count_nodes(value):
+    """Counts the AST nodes of a JSON document, i.e. the objects with a
+    single key naming their kind, other than metadata.
+    """
+    if isinstance(value, list):
+        return sum(count_nodes(element) for element in value)
+    if not isinstance(value, dict):
+        return 0
+    count = 1 if ((len(value) == 1) and ('__meta__' not in value)) else 0
+    return count + sum(count_nodes(child) for key, child in value.items() if key != '__meta__')
+
+
+def run(args, source, report):
+    """Compiles a module, and returns the wall time of each phase."""
+    command = [args.tango, '-O%s' % args.opt_level, '--time-report=%s' % report,
+               '-o', os.devnull, source]
+    subprocess.check_call(command, stderr=subprocess.DEVNULL)
+    with open(report) as f:
+        phases = {phase['name']: phase['wall_seconds'] for phase in json.load(f)['phases']}
+    return {name: sum(phases.get(phase, 0) for phase in parts) for name, parts in PHASES.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('tango', help='path to the tango binary')
+    parser.add_argument('--functions', type=int, default=5000)
+    parser.add_argument('--repeat', type=int, default=3)
+    parser.add_argument('--opt-level', default='2', choices=['0', '1', '2', '3', 's'])
+    parser.add_argument('--scenario', action='append', choices=sorted(SCENARIOS),
+                        help='scenario to run (all of them by default)')
+    parser.add_argument('--json', help='file to which the results are written')
+    args = parser.parse_args()
+
+    results = []
+    generator = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'gen_ast.py')
+    print('%-10s %-9s %8s %10s %12s %12s' % (
+        'scenario', 'phase', 'nodes', 'seconds', 'nodes/s', 'MB/s'))
+
+    with tempfile.TemporaryDirectory() as workdir:
+        source = os.path.join(workdir, 'input.ast')
+        report = os.path.join(workdir, 'report.json')
+        for scenario in (args.scenario or sorted(SCENARIOS)):
+            subprocess.check_call([sys.executable, generator,
+                                   '--functions', str(args.functions)]
+                                  + SCENARIOS[scenario] + [source])
+            with open(source) as f:
+                nodes = count_nodes(json.load(f))
+            size = os.path.getsize(source)
+
+            # Keep the best of several runs, to filter out noise.
+            best = {}
+            for _ in range(args.repeat):
+                for phase, seconds in run(args, source, report).items():
+                    best[phase] = min(best.get(phase, seconds), seconds)
+
+            for phase in sorted(PHASES):
+                seconds = max(best[phase], 1e-9)
+                print('%-10s %-9s %8d %10.4f %12.0f %12.2f' % (
+                    scenario, phase, nodes, seconds, nodes / seconds, size / seconds / 1e6))
+                results.append({
+                    'scenario': scenario, 'phase': phase, 'nodes': nodes, 'bytes': size,
+                    'seconds': best[phase], 'nodes_per_second': nodes / seconds,
+                    'bytes_per_second': size / seconds})
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'functions': args.functions, 'opt_level': args.opt_level,
+                       'results': results}, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
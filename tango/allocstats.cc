@@ -0,0 +1,203 @@
+//
+//  allocstats.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "allocstats.hh"
+
+
+namespace tango {
+
+    /// Bytes allocated by the current thread.
+    ///
+    /// Counters are per thread, so that counting doesn't synchronize
+    /// threads that allocate concurrently.
+    static thread_local std::uint64_t thread_allocated_bytes = 0;
+
+    std::uint64_t get_thread_allocated_bytes() {
+        return thread_allocated_bytes;
+    }
+
+
+    // -----------------------------------------------------------------------
+
+    /// Counters of a category, shared by all threads.
+    struct SharedMemoryCounters {
+        std::atomic<std::uint64_t> allocations;
+        std::atomic<std::uint64_t> allocated_bytes;
+        std::atomic<std::int64_t>  live_bytes;
+        std::atomic<std::int64_t>  peak_live_bytes;
+    };
+
+    /// Counters are zero-initialized before any allocation happens, since
+    /// they're constant-initialized. The last entry sums all categories.
+    static SharedMemoryCounters memory_counters[mc_count + 1];
+    static std::atomic<bool>    is_accounting_enabled(false);
+
+    /// The category of the innermost scope of the current thread.
+    static thread_local MemoryCategory current_category = mc_other;
+
+    const char* get_memory_category_name(MemoryCategory category) {
+        switch (category) {
+            case mc_other: return "other";
+            case mc_json:  return "json";
+            case mc_ast:   return "ast";
+            case mc_types: return "types";
+            case mc_llvm:  return "llvm";
+            default:       return "total";
+        }
+    }
+
+
+    void enable_memory_accounting() {
+        is_accounting_enabled.store(true);
+    }
+
+
+    bool is_memory_accounting_enabled() {
+        return is_accounting_enabled.load(std::memory_order_relaxed);
+    }
+
+
+    MemoryCounters get_memory_counters(MemoryCategory category) {
+        auto& counters = memory_counters[category];
+        MemoryCounters ret;
+        ret.allocations     = counters.allocations.load(std::memory_order_relaxed);
+        ret.allocated_bytes = counters.allocated_bytes.load(std::memory_order_relaxed);
+        ret.live_bytes      = counters.live_bytes.load(std::memory_order_relaxed);
+        ret.peak_live_bytes = counters.peak_live_bytes.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+
+    void reset_peak_live_bytes() {
+        for (auto& counters: memory_counters) {
+            counters.peak_live_bytes.store(counters.live_bytes.load(std::memory_order_relaxed));
+        }
+    }
+
+
+    void set_thread_memory_category(MemoryCategory category) {
+        current_category = category;
+    }
+
+
+    MemoryCategoryScope::MemoryCategoryScope(MemoryCategory category):
+        previous(current_category)
+    {
+        current_category = category;
+    }
+
+
+    MemoryCategoryScope::~MemoryCategoryScope() {
+        current_category = this->previous;
+    }
+
+
+    static std::size_t get_usable_size(void* ptr) {
+#if defined(__APPLE__)
+        return malloc_size(ptr);
+#else
+        return malloc_usable_size(ptr);
+#endif
+    }
+
+
+    /// Adds a number of bytes to the live bytes of some counters, updating
+    /// their peak.
+    static void add_live_bytes(SharedMemoryCounters& counters, std::int64_t bytes) {
+        auto live = counters.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        auto peak = counters.peak_live_bytes.load(std::memory_order_relaxed);
+        while ((live > peak)
+            and !counters.peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {}
+    }
+
+
+    static void account_allocation(SharedMemoryCounters& counters, std::size_t size, std::int64_t usable) {
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        add_live_bytes(counters, usable);
+    }
+
+    // -----------------------------------------------------------------------
+
+    static void* allocate(std::size_t size) {
+        thread_allocated_bytes += size;
+        auto ptr = std::malloc((size > 0) ? size : 1);
+        if ((ptr != nullptr) and is_memory_accounting_enabled()) {
+            auto usable = static_cast<std::int64_t>(get_usable_size(ptr));
+            account_allocation(memory_counters[current_category], size, usable);
+            account_allocation(memory_counters[mc_count], size, usable);
+        }
+        return ptr;
+    }
+
+
+    static void deallocate(void* ptr) {
+        if ((ptr != nullptr) and is_memory_accounting_enabled()) {
+            auto usable = static_cast<std::int64_t>(get_usable_size(ptr));
+            memory_counters[current_category].live_bytes.fetch_sub(usable, std::memory_order_relaxed);
+            memory_counters[mc_count].live_bytes.fetch_sub(usable, std::memory_order_relaxed);
+        }
+        std::free(ptr);
+    }
+
+} // namespace tango
+
+
+void* operator new(std::size_t size) {
+    auto ptr = tango::allocate(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return tango::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return tango::allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    tango::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    tango::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    tango::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    tango::deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    tango::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    tango::deallocate(ptr);
+}
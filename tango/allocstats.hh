@@ -0,0 +1,101 @@
+//
+//  allocstats.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+
+
+namespace tango {
+
+    /// Returns the number of bytes the calling thread has allocated with
+    /// operator new so far.
+    ///
+    /// The global operator new is replaced to count allocations, which
+    /// includes those of the AST arena and of LLVM, but not the memory
+    /// obtained by calling malloc directly.
+    std::uint64_t get_thread_allocated_bytes();
+
+    // -----------------------------------------------------------------------
+
+    /// The data structures to which memory is accounted.
+    enum MemoryCategory {
+        /// Anything that isn't accounted to another category.
+        mc_other,
+        /// The buffers of the JSON reader, and the strings it reads.
+        mc_json,
+        /// The arenas of AST contexts, and flat ASTs.
+        mc_ast,
+        /// The types of the type context.
+        mc_types,
+        /// LLVM contexts and modules, and the passes that transform them.
+        mc_llvm,
+
+        mc_count
+    };
+
+    /// Returns the name of a category, as it appears in memory reports.
+    const char* get_memory_category_name(MemoryCategory category);
+
+    /// Counters of the allocations of a category.
+    ///
+    /// Live bytes are counted with the usable sizes of the blocks returned
+    /// by malloc, so they include allocator rounding.
+    struct MemoryCounters {
+
+        MemoryCounters(): allocations(0), allocated_bytes(0), live_bytes(0), peak_live_bytes(0) {}
+
+        std::uint64_t allocations;
+        std::uint64_t allocated_bytes;
+        std::int64_t  live_bytes;
+        std::int64_t  peak_live_bytes;
+
+    };
+
+    /// Starts counting allocations per category, for all threads.
+    ///
+    /// Counting isn't free, since counters are shared by all threads, hence
+    /// it's disabled by default.
+    void enable_memory_accounting();
+
+    /// Returns whether allocations are counted per category.
+    bool is_memory_accounting_enabled();
+
+    /// Returns the counters of a category, or the sum of those of all
+    /// categories with mc_count.
+    MemoryCounters get_memory_counters(MemoryCategory category);
+
+    /// Resets the peak live bytes of every category to its current live
+    /// bytes, so as to measure the peak of the next phase.
+    void reset_peak_live_bytes();
+
+    /// Sets the category to which the memory the calling thread allocates
+    /// and frees outside of any scope is accounted.
+    ///
+    /// It's meant for worker threads, whose thread-local data is released
+    /// after their function returns, hence after the scopes it declares.
+    void set_thread_memory_category(MemoryCategory category);
+
+    /// Scope that accounts the memory the calling thread allocates and frees
+    /// to a category.
+    ///
+    /// Blocks are accounted to the category of the scope in which they're
+    /// freed, not to the one in which they were allocated, so the live bytes
+    /// of a category are only meaningful if its structures are built and
+    /// released within scopes of that category. Scopes may be nested, e.g.
+    /// to account the nodes created while reading JSON to the AST.
+    struct MemoryCategoryScope {
+
+        MemoryCategoryScope(MemoryCategory category);
+        MemoryCategoryScope(const MemoryCategoryScope&) = delete;
+        ~MemoryCategoryScope();
+
+        MemoryCategory previous;
+
+    };
+
+} // namespace tango
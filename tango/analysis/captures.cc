@@ -0,0 +1,239 @@
+//
+//  captures.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "captures.hh"
+#include "tango/captureinfo.hh"
+#include "tango/trace.hh"
+
+
+namespace tango {
+namespace analysis {
+
+    /// A lexical scope, mapping the names it declares to their declarations.
+    struct CaptureScope {
+        CaptureScope(const CaptureScope* parent, std::size_t depth):
+            parent(parent), depth(depth) {}
+
+        const CaptureScope*               parent;
+        std::unordered_map<Symbol, Decl*> decls;
+
+        /// The number of functions enclosing the scope (0 at the top level).
+        std::size_t depth;
+    };
+
+    /// Visitor that walks the reachable functions of a module, with their
+    /// nested functions, adding the local values they refer to from
+    /// enclosing functions to their capture lists.
+    struct CaptureWalker: public ASTNodeVisitor {
+
+        CaptureWalker(const CaptureOptions& options):
+            options(options), current(nullptr), is_visiting_callee(false), capture_count(0) {}
+
+        std::size_t run(Block& module) {
+            this->walk_block(module, nullptr);
+            return this->capture_count;
+        }
+
+        void walk_block(Block& block, const CaptureScope* parent) {
+            this->scopes.emplace_back(parent, this->functions.size());
+            auto scope = &this->scopes.back();
+            for (auto statement: block.statements) {
+                if (auto decl = dynamic_cast<Decl*>(statement)) {
+                    scope->decls.emplace(decl->name, decl);
+                }
+
+                // Nested functions are liftable until they're referred to
+                // otherwise than by a direct call from their declarer. They
+                // may be called before their declaration is walked.
+                if (auto fun_decl = dynamic_cast<FunctionDecl*>(statement)) {
+                    fun_decl->is_liftable = (scope->depth > 0) and this->options.lift_functions;
+                }
+            }
+
+            auto enclosing = this->current;
+            this->current = scope;
+            for (auto statement: block.statements) {
+                statement->accept(*this);
+                this->mark_initialization(*statement, *scope);
+            }
+            this->current = enclosing;
+        }
+
+        /// Flags the constant a statement assigns as initialized before
+        /// capture if it's declared in the given scope, and no nested
+        /// function has captured it yet. Assignments nested in other
+        /// statements, e.g. in a branch of a condition, don't count.
+        void mark_initialization(ASTNode& statement, const CaptureScope& scope) {
+            auto assignment = dynamic_cast<Assignment*>(&statement);
+            if ((assignment == nullptr) or (assignment->op == ao_ref)) {
+                return;
+            }
+            auto lvalue = dynamic_cast<Identifier*>(assignment->lvalue);
+            if (lvalue == nullptr) {
+                return;
+            }
+
+            auto it = scope.decls.find(lvalue->name);
+            if (it == scope.decls.end()) {
+                return;
+            }
+            auto prop_decl = dynamic_cast<PropertyDecl*>(it->second);
+            if ((prop_decl != nullptr) and (this->captured_values.count(prop_decl) == 0)) {
+                prop_decl->is_initialized_before_capture = true;
+            }
+        }
+
+        /// Adds a local value declared in the scope at the given depth to
+        /// the capture lists of the functions nested deeper.
+        void capture(Decl* decl, std::size_t depth) {
+            if (depth < this->functions.size()) {
+                this->captured_values.insert(decl);
+            }
+            for (auto i = depth; i < this->functions.size(); ++i) {
+                if (this->captured[i].insert(decl).second) {
+                    this->functions[i]->capture_list.push_back(
+                        CapturedValue(decl, !this->options.assume_escaping));
+                    this->capture_count += 1;
+                }
+            }
+        }
+
+        void visit(Block& node) {
+            this->walk_block(node, this->current);
+        }
+
+        void visit(FunctionDecl& node) {
+            if (!node.is_reachable) {
+                return;
+            }
+
+            node.capture_list.clear();
+            this->functions.push_back(&node);
+            this->captured.emplace_back();
+
+            this->scopes.emplace_back(this->current, this->functions.size());
+            auto scope = &this->scopes.back();
+            for (auto parameter: node.parameters) {
+                scope->decls.emplace(parameter->name, parameter);
+            }
+            this->walk_block(*node.get_body(), scope);
+
+            this->captured.pop_back();
+            this->functions.pop_back();
+        }
+
+        void visit(PropertyDecl& node) {
+            node.is_initialized_before_capture = false;
+        }
+
+        void visit(ParamDecl&) {}
+
+        void visit(Assignment& node) {
+            node.lvalue->accept(*this);
+            node.rvalue->accept(*this);
+        }
+
+        void visit(If& node) {
+            node.condition->accept(*this);
+            node.then_block->accept(*this);
+            node.else_block->accept(*this);
+        }
+
+        void visit(Return& node) {
+            node.value->accept(*this);
+        }
+
+        void visit(BinaryExpr& node) {
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(Call& node) {
+            this->is_visiting_callee = dynamic_cast<Identifier*>(node.callee) != nullptr;
+            node.callee->accept(*this);
+            this->is_visiting_callee = false;
+            for (auto argument: node.arguments) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit(CallArg& node) {
+            node.value->accept(*this);
+        }
+
+        void visit(Identifier& node) {
+            bool is_callee = this->is_visiting_callee;
+            this->is_visiting_callee = false;
+
+            for (auto scope = this->current; scope != nullptr; scope = scope->parent) {
+                auto it = scope->decls.find(node.name);
+                if (it == scope->decls.end()) {
+                    continue;
+                }
+
+                // References from deeper functions are either recursive
+                // calls, or calls from functions that would have to capture
+                // the captures of the callee.
+                if (auto fun_decl = dynamic_cast<FunctionDecl*>(it->second)) {
+                    if (!is_callee or (scope->depth != this->functions.size())) {
+                        fun_decl->is_liftable = false;
+                    }
+                }
+
+                // Functions are referred to by their closures, which the IR
+                // generator resolves on its own, and global values need not
+                // be captured.
+                bool is_value = (dynamic_cast<PropertyDecl*>(it->second) != nullptr)
+                             or (dynamic_cast<ParamDecl*>(it->second) != nullptr);
+                if (is_value and (scope->depth > 0)) {
+                    this->capture(it->second, scope->depth);
+                }
+                return;
+            }
+        }
+
+        void visit(IntegerLiteral&) {}
+        void visit(BooleanLiteral&) {}
+
+        CaptureOptions options;
+
+        /// The scopes created so far. A deque keeps their addresses stable.
+        std::deque<CaptureScope> scopes;
+
+        /// The innermost scope of the code being walked.
+        const CaptureScope* current;
+
+        /// The functions being walked, from the outermost one, and the
+        /// values each of them captures so far.
+        std::vector<FunctionDecl*>             functions;
+        std::vector<std::unordered_set<Decl*>> captured;
+
+        /// The values captured by any nested function walked so far.
+        std::unordered_set<Decl*> captured_values;
+
+        /// Whether the identifier about to be visited is the callee of a
+        /// call.
+        bool is_visiting_callee;
+
+        std::size_t capture_count;
+
+    };
+
+
+    std::size_t compute_capture_lists(Block& module, const CaptureOptions& options) {
+        TANGO_TRACE_SCOPE(trace_scope, "captures");
+        CaptureWalker walker(options);
+        return walker.run(module);
+    }
+
+} // namespace analysis
+} // namespace tango
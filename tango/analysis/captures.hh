@@ -0,0 +1,63 @@
+//
+//  captures.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include "tango/ast.hh"
+
+
+namespace tango {
+namespace analysis {
+
+    /// Options of compute_capture_lists, which let benchmarks measure the
+    /// cost of closures.
+    struct CaptureOptions {
+
+        CaptureOptions(): lift_functions(true), assume_escaping(false) {}
+
+        /// Whether nested functions may be flagged as liftable.
+        bool lift_functions;
+
+        /// Whether captured values are flagged as escaping, in which case
+        /// closures allocate their environments on the heap. Otherwise,
+        /// only those mark_escaping_closures finds escaping are.
+        bool assume_escaping;
+
+    };
+
+    /// Computes the capture lists of the nested functions of a module.
+    ///
+    /// A nested function captures the properties and parameters of the
+    /// functions enclosing it that it refers to, either directly or through
+    /// its own nested functions, which capture them from it in turn. Names
+    /// are resolved with respect to lexical scoping, and global declarations
+    /// are never captured. Values are listed in the order of their first
+    /// reference, and flagged as non-escaping unless the options tell
+    /// otherwise, until analysis::mark_escaping_closures runs.
+    ///
+    /// Properties are also flagged as initialized before capture if a
+    /// statement of the block declaring them assigns them before any nested
+    /// function refers to them, so that closures may copy constants rather
+    /// than refer to their location.
+    ///
+    /// Nested functions are also flagged as liftable if all the references
+    /// to them are calls made by the body of the function declaring them,
+    /// rather than by themselves or by other nested functions.
+    ///
+    /// Only reachable functions are walked, so that deferred bodies of
+    /// unreachable functions aren't parsed. Existing capture lists of the
+    /// walked functions are replaced.
+    ///
+    /// Returns the number of captured values.
+    std::size_t compute_capture_lists(
+        Block&                module,
+        const CaptureOptions& options = CaptureOptions());
+
+} // namespace analysis
+} // namespace tango
@@ -0,0 +1,276 @@
+//
+//  escapes.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "escapes.hh"
+#include "tango/captureinfo.hh"
+#include "tango/trace.hh"
+
+
+namespace tango {
+namespace analysis {
+
+    /// A lexical scope, mapping the names it declares to their declarations.
+    ///
+    /// A name may be declared several times in the same scope, in which case
+    /// a reference to it may refer to any of its declarations.
+    struct EscapeScope {
+        EscapeScope(const EscapeScope* parent, std::size_t depth):
+            parent(parent), depth(depth) {}
+
+        const EscapeScope*                     parent;
+        std::unordered_multimap<Symbol, Decl*> decls;
+
+        /// The number of functions enclosing the scope (0 at the top level).
+        std::size_t depth;
+    };
+
+    /// Visitor that walks the reachable functions of a module, recording the
+    /// declarations whose values escape, and the declarations whose values
+    /// escape along with others.
+    ///
+    /// Identifiers escape unless their parent node says otherwise, i.e. when
+    /// they're callees, rvalues stored to local properties or arguments of
+    /// known functions.
+    struct EscapeWalker: public ASTNodeVisitor {
+
+        EscapeWalker(): current(nullptr) {}
+
+        std::size_t run(Block& module) {
+            this->walk_block(module, nullptr);
+
+            // Propagate escapes to the declarations that escape along.
+            std::vector<Decl*> worklist(this->escaping.begin(), this->escaping.end());
+            while (!worklist.empty()) {
+                auto decl = worklist.back();
+                worklist.pop_back();
+
+                auto it = this->dependencies.find(decl);
+                if (it != this->dependencies.end()) {
+                    for (auto dependency: it->second) {
+                        if (this->escaping.insert(dependency).second) {
+                            worklist.push_back(dependency);
+                        }
+                    }
+                }
+            }
+
+            std::size_t ret = 0;
+            for (auto fun_decl: this->nested_functions) {
+                if (this->escaping.count(fun_decl) > 0) {
+                    for (auto& val: fun_decl->capture_list) {
+                        val.is_noescape = false;
+                    }
+                    ret += 1;
+                }
+            }
+            return ret;
+        }
+
+        void walk_block(Block& block, const EscapeScope* parent) {
+            this->scopes.emplace_back(parent, this->functions.size());
+            auto scope = &this->scopes.back();
+            for (auto statement: block.statements) {
+                if (auto decl = dynamic_cast<Decl*>(statement)) {
+                    scope->decls.emplace(decl->name, decl);
+                }
+            }
+
+            auto enclosing = this->current;
+            this->current = scope;
+            for (auto statement: block.statements) {
+                statement->accept(*this);
+            }
+            this->current = enclosing;
+        }
+
+        /// Resolves a name in the current scope, calling `fn` with each of
+        /// the declarations it may refer to and the depth of their scope.
+        ///
+        /// Functions that refer to declarations of enclosing functions take
+        /// them along if they escape.
+        template<typename Fn>
+        void resolve(Symbol name, Fn fn) {
+            for (auto scope = this->current; scope != nullptr; scope = scope->parent) {
+                auto range = scope->decls.equal_range(name);
+                if (range.first == range.second) {
+                    continue;
+                }
+
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (scope->depth > 0) {
+                        for (auto i = scope->depth; i < this->functions.size(); ++i) {
+                            this->dependencies[this->functions[i]].push_back(it->second);
+                        }
+                    }
+                    fn(it->second, scope->depth);
+                }
+                return;
+            }
+        }
+
+        /// Marks the declarations an identifier may refer to as escaping.
+        void escape(Symbol name) {
+            this->resolve(name, [this](Decl* decl, std::size_t) {
+                this->escaping.insert(decl);
+            });
+        }
+
+        /// Records that the value of an expression is stored to `target`,
+        /// so that it escapes if the target does.
+        void store(ASTNode* value, Decl* target) {
+            auto identifier = dynamic_cast<Identifier*>(value);
+            if (identifier == nullptr) {
+                value->accept(*this);
+                return;
+            }
+            this->resolve(identifier->name, [this, target](Decl* decl, std::size_t) {
+                this->dependencies[target].push_back(decl);
+            });
+        }
+
+        void visit(Block& node) {
+            this->walk_block(node, this->current);
+        }
+
+        void visit(FunctionDecl& node) {
+            if (!node.is_reachable) {
+                return;
+            }
+            if (!this->functions.empty()) {
+                this->nested_functions.push_back(&node);
+            }
+            this->functions.push_back(&node);
+
+            this->scopes.emplace_back(this->current, this->functions.size());
+            auto scope = &this->scopes.back();
+            for (auto parameter: node.parameters) {
+                scope->decls.emplace(parameter->name, parameter);
+            }
+            this->walk_block(*node.get_body(), scope);
+
+            this->functions.pop_back();
+        }
+
+        void visit(PropertyDecl&) {}
+        void visit(ParamDecl&)    {}
+
+        void visit(Assignment& node) {
+            auto lvalue = dynamic_cast<Identifier*>(node.lvalue);
+            if (lvalue == nullptr) {
+                node.lvalue->accept(*this);
+            }
+
+            // Values assigned by reference are aliased, and values assigned
+            // to globals outlive any frame.
+            std::vector<Decl*> targets;
+            bool               is_local = (lvalue != nullptr) and (node.op != ao_ref);
+            if (lvalue != nullptr) {
+                this->resolve(lvalue->name, [&](Decl* decl, std::size_t depth) {
+                    targets.push_back(decl);
+                    is_local = is_local and (depth > 0);
+                });
+            }
+
+            if (!is_local or targets.empty()) {
+                node.rvalue->accept(*this);
+                return;
+            }
+            for (auto target: targets) {
+                this->store(node.rvalue, target);
+            }
+        }
+
+        void visit(If& node) {
+            node.condition->accept(*this);
+            node.then_block->accept(*this);
+            node.else_block->accept(*this);
+        }
+
+        void visit(Return& node) {
+            node.value->accept(*this);
+        }
+
+        void visit(BinaryExpr& node) {
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(Call& node) {
+            // Arguments are bound to the parameters of the callee if it is
+            // statically known, and escape otherwise.
+            FunctionDecl* callee = nullptr;
+            if (auto identifier = dynamic_cast<Identifier*>(node.callee)) {
+                std::size_t candidates = 0;
+                this->resolve(identifier->name, [&](Decl* decl, std::size_t) {
+                    callee      = dynamic_cast<FunctionDecl*>(decl);
+                    candidates += 1;
+                });
+                if (candidates != 1) {
+                    callee = nullptr;
+                }
+            } else {
+                node.callee->accept(*this);
+            }
+
+            bool is_known = (callee != nullptr)
+                        and (callee->parameters.size() == node.arguments.size());
+            for (std::size_t i = 0; i < node.arguments.size(); ++i) {
+                auto argument = node.arguments[i];
+                if (is_known and (argument->op != ao_ref)) {
+                    this->store(argument->value, callee->parameters[i]);
+                } else {
+                    argument->accept(*this);
+                }
+            }
+        }
+
+        void visit(CallArg& node) {
+            node.value->accept(*this);
+        }
+
+        void visit(Identifier& node) {
+            this->escape(node.name);
+        }
+
+        void visit(IntegerLiteral&) {}
+        void visit(BooleanLiteral&) {}
+
+        /// The scopes created so far. A deque keeps their addresses stable.
+        std::deque<EscapeScope> scopes;
+
+        /// The innermost scope of the code being walked.
+        const EscapeScope* current;
+
+        /// The functions being walked, from the outermost one, and all the
+        /// reachable nested functions walked so far.
+        std::vector<FunctionDecl*> functions;
+        std::vector<FunctionDecl*> nested_functions;
+
+        /// The declarations whose values escape directly.
+        std::unordered_set<Decl*> escaping;
+
+        /// Maps declarations to those whose values escape along with theirs,
+        /// i.e. the values stored to them, and the declarations of enclosing
+        /// functions they refer to if they're functions.
+        std::unordered_map<Decl*, std::vector<Decl*>> dependencies;
+
+    };
+
+
+    std::size_t mark_escaping_closures(Block& module) {
+        TANGO_TRACE_SCOPE(trace_scope, "escapes");
+        EscapeWalker walker;
+        return walker.run(module);
+    }
+
+} // namespace analysis
+} // namespace tango
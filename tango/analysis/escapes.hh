@@ -0,0 +1,39 @@
+//
+//  escapes.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include "tango/ast.hh"
+
+
+namespace tango {
+namespace analysis {
+
+    /// Flags the captures of the nested functions whose closures may outlive
+    /// the frame of the function that declares them as escaping.
+    ///
+    /// A closure escapes when it is returned, assigned by reference, stored
+    /// to a global, or passed to a callee that isn't statically known. Values
+    /// stored to local properties, or passed to the parameters of a known
+    /// function, escape if those properties or parameters do. Closures that
+    /// escape also take along the values they capture. Calling a closure
+    /// never makes it escape.
+    ///
+    /// The analysis is flow insensitive, and names declared several times in
+    /// the same scope are considered to refer to all their declarations, so
+    /// it is conservative. It must run after compute_capture_lists, and only
+    /// walks reachable functions. Captures of non-escaping closures are left
+    /// as they are, so that compute_capture_lists' options may still force
+    /// closures to escape.
+    ///
+    /// Returns the number of escaping nested functions.
+    std::size_t mark_escaping_closures(Block& module);
+
+} // namespace analysis
+} // namespace tango
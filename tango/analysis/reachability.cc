@@ -0,0 +1,171 @@
+//
+//  reachability.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "reachability.hh"
+#include "tango/trace.hh"
+
+
+namespace tango {
+namespace analysis {
+
+    /// A lexical scope, mapping the names it declares to their declarations.
+    ///
+    /// A name may be declared several times in the same scope, in which case
+    /// a reference to it may refer to any of its declarations.
+    struct Scope {
+        Scope(const Scope* parent): parent(parent) {}
+
+        const Scope*                           parent;
+        std::unordered_multimap<Symbol, Decl*> decls;
+    };
+
+    /// Visitor that walks the code reachable from the top-level statements
+    /// of a module, marking the functions it refers to.
+    ///
+    /// Functions are walked once, from a worklist, in the scope in which
+    /// they were declared rather than in that of their callers.
+    struct ReachabilityWalker: public ASTNodeVisitor {
+
+        ReachabilityWalker(): current(nullptr), reachable_count(0) {}
+
+        std::size_t run(Block& module) {
+            this->walk_block(module, nullptr);
+            while (!this->worklist.empty()) {
+                auto fun_decl = this->worklist.back();
+                this->worklist.pop_back();
+                this->walk_function(*fun_decl);
+            }
+            return this->reachable_count;
+        }
+
+        /// Walks the statements of a block, in a new scope that holds its
+        /// declarations. Nested functions are only walked if they're reached.
+        void walk_block(Block& block, const Scope* parent) {
+            this->scopes.emplace_back(parent);
+            auto scope = &this->scopes.back();
+            for (auto statement: block.statements) {
+                if (auto decl = dynamic_cast<Decl*>(statement)) {
+                    scope->decls.emplace(decl->name, decl);
+                }
+                if (auto fun_decl = dynamic_cast<FunctionDecl*>(statement)) {
+                    fun_decl->is_reachable = false;
+                    this->declaring_scopes[fun_decl] = scope;
+                }
+            }
+
+            auto enclosing = this->current;
+            this->current = scope;
+            for (auto statement: block.statements) {
+                statement->accept(*this);
+            }
+            this->current = enclosing;
+        }
+
+        void walk_function(FunctionDecl& fun_decl) {
+            this->scopes.emplace_back(this->declaring_scopes[&fun_decl]);
+            auto scope = &this->scopes.back();
+            for (auto parameter: fun_decl.parameters) {
+                scope->decls.emplace(parameter->name, parameter);
+            }
+            this->walk_block(*fun_decl.get_body(), scope);
+        }
+
+        /// Marks the functions a name may refer to in the current scope.
+        void resolve(Symbol name) {
+            for (auto scope = this->current; scope != nullptr; scope = scope->parent) {
+                auto range = scope->decls.equal_range(name);
+                if (range.first == range.second) {
+                    continue;
+                }
+
+                for (auto it = range.first; it != range.second; ++it) {
+                    auto fun_decl = dynamic_cast<FunctionDecl*>(it->second);
+                    if ((fun_decl != nullptr) and !fun_decl->is_reachable) {
+                        fun_decl->is_reachable = true;
+                        this->reachable_count += 1;
+                        this->worklist.push_back(fun_decl);
+                    }
+                }
+                return;
+            }
+        }
+
+        void visit(Block& node) {
+            this->walk_block(node, this->current);
+        }
+
+        void visit(PropertyDecl&) {}
+        void visit(ParamDecl&)    {}
+        void visit(FunctionDecl&) {}
+
+        void visit(Assignment& node) {
+            node.lvalue->accept(*this);
+            node.rvalue->accept(*this);
+        }
+
+        void visit(If& node) {
+            node.condition->accept(*this);
+            node.then_block->accept(*this);
+            node.else_block->accept(*this);
+        }
+
+        void visit(Return& node) {
+            node.value->accept(*this);
+        }
+
+        void visit(BinaryExpr& node) {
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(Call& node) {
+            node.callee->accept(*this);
+            for (auto argument: node.arguments) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit(CallArg& node) {
+            node.value->accept(*this);
+        }
+
+        void visit(Identifier& node) {
+            this->resolve(node.name);
+        }
+
+        void visit(IntegerLiteral&) {}
+        void visit(BooleanLiteral&) {}
+
+        /// The scopes created so far. A deque keeps their addresses stable.
+        std::deque<Scope> scopes;
+
+        /// The innermost scope of the code being walked.
+        const Scope* current;
+
+        /// The scope in which each function was declared.
+        std::unordered_map<FunctionDecl*, const Scope*> declaring_scopes;
+
+        /// The reachable functions whose bodies are yet to be walked.
+        std::vector<FunctionDecl*> worklist;
+
+        std::size_t reachable_count;
+
+    };
+
+
+    std::size_t mark_reachable_functions(Block& module) {
+        TANGO_TRACE_SCOPE(trace_scope, "reachability");
+        ReachabilityWalker walker;
+        return walker.run(module);
+    }
+
+} // namespace analysis
+} // namespace tango
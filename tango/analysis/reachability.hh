@@ -0,0 +1,37 @@
+//
+//  reachability.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include "tango/ast.hh"
+
+
+namespace tango {
+namespace analysis {
+
+    /// Marks the function declarations of a module that may be called when
+    /// its top-level statements are executed.
+    ///
+    /// The call graph is built from the identifiers of the module, starting
+    /// at its top-level statements (i.e. the body of `main`), and resolving
+    /// names with respect to lexical scoping. Any reference to a function
+    /// is an edge, not only callees, so functions that escape as values are
+    /// considered reachable as well. Declarations of the same block are
+    /// visible from all its statements, so mutually recursive functions may
+    /// call each other.
+    ///
+    /// Functions that aren't reachable have their `is_reachable` flag unset,
+    /// and their bodies are never visited, so deferred bodies of
+    /// unreachable functions are never parsed.
+    ///
+    /// Returns the number of reachable function declarations.
+    std::size_t mark_reachable_functions(Block& module);
+
+} // namespace analysis
+} // namespace tango
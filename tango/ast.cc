@@ -6,20 +6,22 @@
 //  Copyright © 2017 University of Geneva. All rights reserved.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "allocstats.hh"
 #include "ast.hh"
+#include "jsonreader.hh"
+#include "mappedfile.hh"
+#include "trace.hh"
 #include "types.hh"
-#include "json/json.hpp"
 
 
 namespace tango {
 
-    Block::~Block() {
-        for(std::size_t i = 0; i < this->statements.size(); ++i) {
-            delete this->statements[i];
-            this->statements[i] = nullptr;
-        }
-    }
-
     void Block::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
@@ -38,82 +40,42 @@ namespace tango {
 
     // -----------------------------------------------------------------------
 
-    FunctionDecl::~FunctionDecl() {
-        for(std::size_t i = 0; i < this->parameters.size(); ++i) {
-            delete this->parameters[i];
-            this->parameters[i] = nullptr;
-        }
-        delete this->body;
-    }
-
     void FunctionDecl::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
 
     // -----------------------------------------------------------------------
 
-    Assignment::~Assignment() {
-        delete this->lvalue;
-        delete this->rvalue;
-    }
-
     void Assignment::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
 
     // -----------------------------------------------------------------------
 
-    If::~If() {
-        delete this->condition;
-        delete this->then_block;
-        delete this->else_block;
-    }
-
     void If::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
 
     // -----------------------------------------------------------------------
 
-    Return::~Return() {
-        delete this->value;
-    }
-
     void Return::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
 
     // -----------------------------------------------------------------------
 
-    BinaryExpr::~BinaryExpr() {
-        delete this->left;
-        delete this->right;
-    }
-
     void BinaryExpr::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
 
     // -----------------------------------------------------------------------
 
-    Call::~Call() {
-        delete this->callee;
-        for(std::size_t i = 0; i < this->arguments.size(); ++i) {
-            delete this->arguments[i];
-            this->arguments[i] = nullptr;
-        }
-    }
-
     void Call::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
 
     // -----------------------------------------------------------------------
 
-    CallArg::~CallArg() {
-        delete this->value;
-    }
-
     void CallArg::accept(ASTNodeVisitor& visitor) {
         visitor.visit(*this);
     }
@@ -138,178 +100,808 @@ namespace tango {
 
     // -----------------------------------------------------------------------
 
-    Block*        parse_block     (nlohmann::json& data);
-    PropertyDecl* parse_prop_decl (nlohmann::json& data);
-    ParamDecl*    parse_param_decl(nlohmann::json& data);
-    FunctionDecl* parse_fun_decl  (nlohmann::json& data);
-    Assignment*   parse_assignment(nlohmann::json& data);
-    If*           parse_if        (nlohmann::json& data);
-    Return*       parse_return    (nlohmann::json& data);
-    Call*         parse_call      (nlohmann::json& data);
-    CallArg*      parse_call_arg  (nlohmann::json& data);
-    Identifier*   parse_identifier(nlohmann::json& data);
-    ASTNode*      parse_literal   (nlohmann::json& data);
-
-    ASTNode* parse_node(nlohmann::json& data) {
-        std::cout << data << std::endl;
-        nlohmann::json::iterator it = data.find("PropertyDecl");
-        if (it != data.end()) { return parse_prop_decl(it.value()); }
-        it = data.find("FunctionParameter");
-        if (it != data.end()) { return parse_param_decl(it.value()); }
-        it = data.find("FunctionDecl");
-        if (it != data.end()) { return parse_fun_decl(it.value()); }
-        it = data.find("Assignment");
-        if (it != data.end()) { return parse_assignment(it.value()); }
-        it = data.find("If");
-        if (it != data.end()) { return parse_if(it.value()); }
-        it = data.find("Return");
-        if (it != data.end()) { return parse_return(it.value()); }
-        it = data.find("Call");
-        if (it != data.end()) { return parse_call(it.value()); }
-        it = data.find("CallArgument");
-        if (it != data.end()) { return parse_call_arg(it.value()); }
-        it = data.find("Identifier");
-        if (it != data.end()) { return parse_identifier(it.value()); }
-        it = data.find("Literal");
-        if (it != data.end()) { return parse_literal(it.value()); }
-
-        assert(false);
-    }
-
-    Block* parse_block(nlohmann::json& data) {
-        std::vector<ASTNode*> statements;
-        for (auto stmt: data.at("statements")) {
-            statements.push_back(parse_node(stmt));
-        }
-        return new Block(statements);
-    }
-
-    PropertyDecl* parse_prop_decl(nlohmann::json& data) {
-        PropertyDecl* ret;
-        if (data.at("mutability") == "cst") {
-            ret = new PropertyDecl(data.at("name"), im_cst);
-        } else if (data.at("mutability") == "mut") {
-            ret = new PropertyDecl(data.at("name"), im_mut);
+    // The following functions build AST nodes as the JSON reader walks
+    // through the input, so that we never have to hold a DOM of the whole
+    // document in memory. Each of them is called once the key that names the
+    // kind of the node has been read, and consumes the object that describes
+    // the node's properties.
+
+    ASTNode*      parse_node       (JSONReader& reader, ASTContext& context);
+    Block*        parse_block      (JSONReader& reader, ASTContext& context);
+    PropertyDecl* parse_prop_decl  (JSONReader& reader, ASTContext& context);
+    ParamDecl*    parse_param_decl (JSONReader& reader, ASTContext& context);
+    FunctionDecl* parse_fun_decl   (JSONReader& reader, ASTContext& context);
+    Assignment*   parse_assignment (JSONReader& reader, ASTContext& context);
+    If*           parse_if         (JSONReader& reader, ASTContext& context);
+    Return*       parse_return     (JSONReader& reader, ASTContext& context);
+    BinaryExpr*   parse_binary_expr(JSONReader& reader, ASTContext& context);
+    Call*         parse_call       (JSONReader& reader, ASTContext& context);
+    CallArg*      parse_call_arg   (JSONReader& reader, ASTContext& context);
+    Identifier*   parse_identifier (JSONReader& reader, ASTContext& context);
+    ASTNode*      parse_literal    (JSONReader& reader, ASTContext& context);
+
+    /// Stack of the children of the nodes being parsed.
+    ///
+    /// Parse functions push the children they read on top of this stack,
+    /// and move them to the arena once the node is complete, so that
+    /// collecting the children of a node doesn't allocate.
+    static thread_local std::vector<ASTNode*> parsed_children;
+
+    /// The file of the AST being parsed, if function bodies should be
+    /// deferred rather than parsed.
+    struct DeferredBodySource {
+        DeferredBodySource(const std::string& path, ASTContext& context):
+            file(path), context(context) {}
+
+        MappedFile  file;
+        ASTContext& context;
+
+        /// Serializes the allocations of deferred bodies in the context,
+        /// which may be requested from several threads.
+        mutable std::mutex mutex;
+    };
+
+    static thread_local const DeferredBodySource* deferred_body_source = nullptr;
+
+    /// Parses a deferred function body.
+    Block* parse_deferred_body(const DeferredBodySource& source, std::size_t offset);
+
+    /// Sets the source of deferred bodies for the lifetime of the scope.
+    struct DeferredBodyScope {
+        DeferredBodyScope(const DeferredBodySource* source):
+            previous(deferred_body_source)
+        {
+            deferred_body_source = source;
+        }
+
+        ~DeferredBodyScope() {
+            deferred_body_source = this->previous;
+        }
+
+        const DeferredBodySource* previous;
+    };
+
+    /// Moves the children pushed on parsed_children since `base` into a list
+    /// allocated in the context.
+    template<typename T>
+    ASTVector<T*> pop_parsed_children(std::size_t base, ASTContext& context) {
+        auto ret = context.list<T*>();
+        ret.reserve(parsed_children.size() - base);
+        for (auto it = parsed_children.begin() + base; it != parsed_children.end(); ++it) {
+            ret.push_back(static_cast<T*>(*it));
+        }
+        parsed_children.resize(base);
+        return ret;
+    }
+
+    /// Parses a node and makes sure it is of the expected kind.
+    template<typename T>
+    T* parse_node_of_kind(JSONReader& reader, ASTContext& context, const char* kind) {
+        auto node = dynamic_cast<T*>(parse_node(reader, context));
+        if (node == nullptr) {
+            reader.error(std::string("expected a node of kind ") + kind);
+        }
+        return node;
+    }
+
+    IdentifierMutability parse_mutability(JSONReader& reader) {
+        auto mutability = reader.read_string();
+        if (mutability == "cst") {
+            return im_cst;
+        } else if (mutability == "mut") {
+            return im_mut;
+        }
+        reader.error("invalid mutability '" + mutability + "'");
+    }
+
+    AssignmentOperator parse_assignment_operator(JSONReader& reader) {
+        auto op = reader.read_string();
+        if (op == "=") {
+            return ao_cpy;
+        } else if (op == "&-") {
+            return ao_ref;
+        } else if (op == "<-") {
+            return ao_mov;
+        }
+        reader.error("invalid assignment operator '" + op + "'");
+    }
+
+    Operator parse_operator(JSONReader& reader) {
+        auto op = reader.read_string();
+        if (op == "+")  { return add; }
+        if (op == "-")  { return sub; }
+        if (op == "*")  { return mul; }
+        if (op == "/")  { return div; }
+        if (op == "<")  { return lt; }
+        if (op == "<=") { return le; }
+        if (op == ">")  { return gt; }
+        if (op == ">=") { return ge; }
+        if (op == "==") { return eq; }
+        if (op == "!=") { return ne; }
+        reader.error("invalid operator '" + op + "'");
+    }
+
+    void parse_position(JSONReader& reader, unsigned& line, unsigned& column) {
+        std::size_t idx = 0;
+        reader.begin_array();
+        while (reader.next_element()) {
+            auto val = static_cast<unsigned>(reader.read_number());
+            if (idx == 0) {
+                line = val;
+            } else if (idx == 1) {
+                column = val;
+            }
+            idx += 1;
+        }
+    }
+
+    SourceRange parse_meta(JSONReader& reader) {
+        SourceRange ret;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "start") {
+                parse_position(reader, ret.start_line, ret.start_column);
+            } else if (key == "end") {
+                parse_position(reader, ret.end_line, ret.end_column);
+            } else {
+                reader.skip_value();
+            }
+        }
+        return ret;
+    }
+
+    ASTNode* parse_node(JSONReader& reader, ASTContext& context) {
+        std::string kind;
+        reader.begin_object();
+        if (!reader.next_key(kind)) {
+            reader.error("expected an AST node");
+        }
+
+        ASTNode* ret;
+        if (kind == "Block") {
+            ret = parse_block(reader, context);
+        } else if (kind == "PropertyDecl") {
+            ret = parse_prop_decl(reader, context);
+        } else if (kind == "FunctionParameter") {
+            ret = parse_param_decl(reader, context);
+        } else if (kind == "FunctionDecl") {
+            ret = parse_fun_decl(reader, context);
+        } else if (kind == "Assignment") {
+            ret = parse_assignment(reader, context);
+        } else if (kind == "If") {
+            ret = parse_if(reader, context);
+        } else if (kind == "Return") {
+            ret = parse_return(reader, context);
+        } else if (kind == "BinaryExpression") {
+            ret = parse_binary_expr(reader, context);
+        } else if (kind == "Call") {
+            ret = parse_call(reader, context);
+        } else if (kind == "CallArgument") {
+            ret = parse_call_arg(reader, context);
+        } else if (kind == "Identifier") {
+            ret = parse_identifier(reader, context);
+        } else if (kind == "Literal") {
+            ret = parse_literal(reader, context);
         } else {
-            assert(false);
+            reader.error("unknown node kind '" + kind + "'");
+        }
+
+        if (reader.next_key(kind)) {
+            reader.error("unexpected key '" + kind + "' after node");
+        }
+        return ret;
+    }
+
+    Block* parse_block(JSONReader& reader, ASTContext& context) {
+        std::size_t base = parsed_children.size();
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "statements") {
+                reader.begin_array();
+                while (reader.next_element()) {
+                    parsed_children.push_back(parse_node(reader, context));
+                }
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
+        }
+
+        auto ret = context.create<Block>(pop_parsed_children<ASTNode>(base, context));
+        ret->md_range = range;
+        return ret;
+    }
+
+    PropertyDecl* parse_prop_decl(JSONReader& reader, ASTContext& context) {
+        Symbol               name;
+        IdentifierMutability mutability = im_cst;
+        SourceRange          range;
+        std::string          key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "name") {
+                name = Symbol(reader.read_string());
+            } else if (key == "mutability") {
+                mutability = parse_mutability(reader);
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
         }
 
+        auto ret = context.create<PropertyDecl>(name, mutability);
+        ret->md_range = range;
         // TODO: Parse types property.
         ret->set_type(IntType::get());
         return ret;
     }
 
-    ParamDecl* parse_param_decl(nlohmann::json& data) {
-        ParamDecl* ret;
-        if (data.at("mutability") == "cst") {
-            ret = new ParamDecl(data.at("name"), im_cst);
-        } else if (data.at("mutability") == "mut") {
-            ret = new ParamDecl(data.at("name"), im_mut);
-        } else {
-            assert(false);
+    ParamDecl* parse_param_decl(JSONReader& reader, ASTContext& context) {
+        Symbol               name;
+        IdentifierMutability mutability = im_cst;
+        SourceRange          range;
+        std::string          key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "name") {
+                name = Symbol(reader.read_string());
+            } else if (key == "mutability") {
+                mutability = parse_mutability(reader);
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
         }
 
+        auto ret = context.create<ParamDecl>(name, mutability);
+        ret->md_range = range;
         // TODO: Parse types property.
         ret->set_type(IntType::get());
         return ret;
     }
 
-    FunctionDecl* parse_fun_decl(nlohmann::json& data) {
-        auto ret = new FunctionDecl(
-            data.at("name"),
-            {parse_param_decl(data.at("parameter").at("FunctionParameter"))},
-            parse_block(data.at("body").at("Block")));
+    FunctionDecl* parse_fun_decl(JSONReader& reader, ASTContext& context) {
+        TANGO_TRACE_SCOPE(trace_scope, "parse FunctionDecl");
+        Symbol      name;
+        std::size_t base        = parsed_children.size();
+        Block*      body        = nullptr;
+        bool        is_deferred = false;
+        std::size_t body_offset = 0;
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "name") {
+                name = Symbol(reader.read_string());
+            } else if (key == "parameter") {
+                parsed_children.push_back(
+                    parse_node_of_kind<ParamDecl>(reader, context, "FunctionParameter"));
+            } else if ((key == "body") and (deferred_body_source != nullptr)) {
+                // Skip over the body, and remember where it starts.
+                auto& file = deferred_body_source->file;
+                reader.peek();
+                body_offset = reader.offset();
+                reader.seek(skip_json_value(
+                    reinterpret_cast<const char*>(file.data), file.size, body_offset));
+                is_deferred = true;
+            } else if (key == "body") {
+                body = parse_node_of_kind<Block>(reader, context, "Block");
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
+        }
+
+        if ((body == nullptr) and !is_deferred) {
+            reader.error("function declaration without a body");
+        }
+        TANGO_TRACE_DETAIL(trace_scope, name.str());
+        auto ret = context.create<FunctionDecl>(
+            name, pop_parsed_children<ParamDecl>(base, context), body);
+        ret->md_range = range;
+        if (is_deferred) {
+            ret->deferred_body_source = deferred_body_source;
+            ret->deferred_body_offset = body_offset;
+        }
 
         // TODO: Parse types property.
-        ret->set_type(FunctionType::get(
-            {IntType::get()},
-            {data.at("parameter").at("FunctionParameter").at("name")},
-            IntType::get()));
+        std::vector<TypePtr> domain;
+        std::vector<Symbol>  labels;
+        for (auto param: ret->parameters) {
+            domain.push_back(IntType::get());
+            labels.push_back(param->name);
+        }
+        ret->set_type(FunctionType::get(domain, labels, IntType::get()));
         return ret;
     }
 
-    Assignment* parse_assignment(nlohmann::json& data) {
-        auto lvalue = parse_node(data.at("lvalue"));
-        auto rvalue = parse_node(data.at("rvalue"));
-        AssignmentOperator op;
-
-        if (data.at("operator") == "=") {
-            op = ao_cpy;
-        } else if (data.at("operator") == "&-") {
-            op = ao_ref;
-        } else if (data.at("operator") == "<-") {
-            op = ao_mov;
-        } else {
-            assert(false);
+    Assignment* parse_assignment(JSONReader& reader, ASTContext& context) {
+        ASTNode*           lvalue = nullptr;
+        ASTNode*           rvalue = nullptr;
+        AssignmentOperator op     = ao_cpy;
+        SourceRange        range;
+        std::string        key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "lvalue") {
+                lvalue = parse_node(reader, context);
+            } else if (key == "rvalue") {
+                rvalue = parse_node(reader, context);
+            } else if (key == "operator") {
+                op = parse_assignment_operator(reader);
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
         }
 
-        return new Assignment(lvalue, op, rvalue);
+        if ((lvalue == nullptr) or (rvalue == nullptr)) {
+            reader.error("incomplete assignment");
+        }
+        auto ret = context.create<Assignment>(lvalue, op, rvalue);
+        ret->md_range = range;
+        return ret;
     }
 
-    If* parse_if(nlohmann::json& data) {
+    If* parse_if(JSONReader& reader, ASTContext& context) {
+        Block*      then_block = nullptr;
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "body") {
+                then_block = parse_node_of_kind<Block>(reader, context, "Block");
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
+        }
+
+        if (then_block == nullptr) {
+            reader.error("conditional statement without a body");
+        }
+
         // Parse conditions properly.
-        auto condition = new BooleanLiteral(true);
+        auto condition = context.create<BooleanLiteral>(true);
         condition->set_type(BoolType::get());
 
-        return new If(condition, parse_block(data.at("body").at("Block")), new Block({}));
+        auto else_block = context.create<Block>(context.list<ASTNode*>());
+        auto ret        = context.create<If>(condition, then_block, else_block);
+        ret->md_range = range;
+        return ret;
     }
 
-    Return* parse_return(nlohmann::json& data) {
-        return new Return(parse_node(data.at("value")));
+    Return* parse_return(JSONReader& reader, ASTContext& context) {
+        ASTNode*    value = nullptr;
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "value") {
+                value = parse_node(reader, context);
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
+        }
+
+        if (value == nullptr) {
+            reader.error("return statement without a value");
+        }
+        auto ret = context.create<Return>(value);
+        ret->md_range = range;
+        return ret;
     }
 
-    Call* parse_call(nlohmann::json& data) {
-        auto callee = parse_node(data.at("callee"));
-        std::vector<CallArg*> arguments;
-        for (auto arg: data.at("arguments")) {
-            arguments.push_back(parse_call_arg(arg.at("CallArgument")));
+    BinaryExpr* parse_binary_expr(JSONReader& reader, ASTContext& context) {
+        ASTNode*    left  = nullptr;
+        ASTNode*    right = nullptr;
+        Operator    op    = add;
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "left") {
+                left = parse_node(reader, context);
+            } else if (key == "right") {
+                right = parse_node(reader, context);
+            } else if (key == "operator") {
+                op = parse_operator(reader);
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
         }
 
-        auto ret = new Call(callee, arguments);
+        if ((left == nullptr) or (right == nullptr)) {
+            reader.error("incomplete binary expression");
+        }
+        auto ret = context.create<BinaryExpr>(left, right, op);
+        ret->md_range = range;
         // TODO: Parse types property.
         ret->set_type(IntType::get());
         return ret;
     }
 
-    CallArg* parse_call_arg(nlohmann::json& data) {
-        auto value = parse_node(data.at("value"));
-        AssignmentOperator op;
+    Call* parse_call(JSONReader& reader, ASTContext& context) {
+        ASTNode*    callee = nullptr;
+        std::size_t base   = parsed_children.size();
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "callee") {
+                callee = parse_node(reader, context);
+            } else if (key == "arguments") {
+                reader.begin_array();
+                while (reader.next_element()) {
+                    parsed_children.push_back(
+                        parse_node_of_kind<CallArg>(reader, context, "CallArgument"));
+                }
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
+        }
 
-        if (data.at("operator") == "=") {
-            op = ao_cpy;
-        } else if (data.at("operator") == "&-") {
-            op = ao_ref;
-        } else if (data.at("operator") == "<-") {
-            op = ao_mov;
-        } else {
-            assert(false);
+        if (callee == nullptr) {
+            reader.error("call without a callee");
+        }
+        auto ret = context.create<Call>(callee, pop_parsed_children<CallArg>(base, context));
+        ret->md_range = range;
+        // TODO: Parse types property.
+        ret->set_type(IntType::get());
+        return ret;
+    }
+
+    CallArg* parse_call_arg(JSONReader& reader, ASTContext& context) {
+        Symbol             label;
+        ASTNode*           value = nullptr;
+        AssignmentOperator op    = ao_cpy;
+        SourceRange        range;
+        std::string        key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "label") {
+                label = Symbol(reader.read_string());
+            } else if (key == "value") {
+                value = parse_node(reader, context);
+            } else if (key == "operator") {
+                op = parse_assignment_operator(reader);
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
         }
 
-        return new CallArg(data.at("label"), op, value);
+        if (value == nullptr) {
+            reader.error("call argument without a value");
+        }
+        auto ret = context.create<CallArg>(label, op, value);
+        ret->md_range = range;
+        return ret;
     }
 
-    Identifier* parse_identifier(nlohmann::json& data) {
-        std::string name = data.at("name");
-        auto ret = new Identifier(name);
+    Identifier* parse_identifier(JSONReader& reader, ASTContext& context) {
+        Symbol      name;
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "name") {
+                name = Symbol(reader.read_string());
+            } else if (key == "__meta__") {
+                range = parse_meta(reader);
+            } else {
+                reader.skip_value();
+            }
+        }
+
+        auto ret = context.create<Identifier>(name);
+        ret->md_range = range;
         // TODO: Parse types property.
         ret->set_type(IntType::get());
         return ret;
     }
 
-    ASTNode* parse_literal(nlohmann::json& data) {
-        // TODO: Parse types property.
-        double val = data.at("value");
-        auto   ret = new IntegerLiteral(int(val));
-        ret->set_type(IntType::get());
+    ASTNode* parse_literal(JSONReader& reader, ASTContext& context) {
+        ASTNode*    ret = nullptr;
+        SourceRange range;
+        std::string key;
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "__meta__") {
+                range = parse_meta(reader);
+                continue;
+            } else if (key != "value") {
+                reader.skip_value();
+                continue;
+            }
+
+            // The frontend may serialize literal values either as JSON
+            // literals or as strings.
+            switch (reader.peek()) {
+                case 't':
+                case 'f':
+                    ret = context.create<BooleanLiteral>(reader.read_bool());
+                    ret->set_type(BoolType::get());
+                    break;
+                case '"': {
+                    auto val = reader.read_string();
+                    if ((val == "true") or (val == "false")) {
+                        ret = context.create<BooleanLiteral>(val == "true");
+                        ret->set_type(BoolType::get());
+                    } else {
+                        // TODO: Parse types property.
+                        ret = context.create<IntegerLiteral>(std::stoi(val));
+                        ret->set_type(IntType::get());
+                    }
+                    break;
+                }
+                default:
+                    // TODO: Parse types property.
+                    ret = context.create<IntegerLiteral>(int(reader.read_number()));
+                    ret->set_type(IntType::get());
+            }
+        }
+
+        if (ret == nullptr) {
+            reader.error("literal without a value");
+        }
+        ret->md_range = range;
+        return ret;
+    }
+
+    Block* read_ast(std::istream& is, ASTContext& context) {
+        JSONReader  reader(is);
+        Block*      body = nullptr;
+        std::string key;
+
+        // Discard the children left over by a previous failed parse.
+        parsed_children.clear();
+
+        reader.begin_object();
+        if (!reader.next_key(key) or (key != "ModuleDecl")) {
+            reader.error("expected a module declaration");
+        }
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key == "body") {
+                body = parse_node_of_kind<Block>(reader, context, "Block");
+            } else {
+                reader.skip_value();
+            }
+        }
+
+        if (reader.next_key(key)) {
+            reader.error("unexpected key '" + key + "' after module declaration");
+        }
+        if (body == nullptr) {
+            reader.error("module declaration without a body");
+        }
+        return body;
+    }
+
+    /// Top-level statements of a module, located but not parsed yet.
+    struct ModuleOutline {
+        SourceRange              range;
+        std::vector<std::size_t> statements;
+    };
+
+    /// Walks the module declaration to locate its top-level statements,
+    /// skipping over their contents.
+    ///
+    /// Statements are skipped by scanning the mapped file for matching
+    /// brackets, which is much faster than tokenizing them, so that this
+    /// sequential pass doesn't bound the speedup of the parallel one.
+    static ModuleOutline read_module_outline(const MappedFile& file) {
+        auto          data = reinterpret_cast<const char*>(file.data);
+        MemoryBuffer  buffer(file.data, file.size);
+        std::istream  is(&buffer);
+        JSONReader    reader(is);
+        ModuleOutline ret;
+        bool          has_body = false;
+        std::string   key;
+
+        reader.begin_object();
+        if (!reader.next_key(key) or (key != "ModuleDecl")) {
+            reader.error("expected a module declaration");
+        }
+
+        reader.begin_object();
+        while (reader.next_key(key)) {
+            if (key != "body") {
+                reader.skip_value();
+                continue;
+            }
+
+            reader.begin_object();
+            if (!reader.next_key(key) or (key != "Block")) {
+                reader.error("expected a node of kind 'Block'");
+            }
+            reader.begin_object();
+            while (reader.next_key(key)) {
+                if (key == "statements") {
+                    reader.begin_array();
+                    while (reader.next_element()) {
+                        reader.peek();
+                        ret.statements.push_back(reader.offset());
+                        reader.seek(skip_json_value(data, file.size, reader.offset()));
+                    }
+                } else if (key == "__meta__") {
+                    ret.range = parse_meta(reader);
+                } else {
+                    reader.skip_value();
+                }
+            }
+            if (reader.next_key(key)) {
+                reader.error("unexpected key '" + key + "' after node");
+            }
+            has_body = true;
+        }
+
+        if (reader.next_key(key)) {
+            reader.error("unexpected key '" + key + "' after module declaration");
+        }
+        if (!has_body) {
+            reader.error("module declaration without a body");
+        }
         return ret;
     }
 
-    std::unique_ptr<ASTNode> read_ast(std::ifstream& ifs) {
-        nlohmann::json ast_data;
-        ifs >> ast_data;
+    Block* parse_deferred_body(const DeferredBodySource& source, std::size_t offset) {
+        TANGO_TRACE_SCOPE(trace_scope, "parse deferred body");
+        MemoryCategoryScope memory_scope(mc_json);
+        MemoryBuffer buffer(source.file.data, source.file.size);
+        std::istream is(&buffer);
+        buffer.pubseekpos(static_cast<std::streamoff>(offset));
+
+        // The bodies of nested functions are deferred as well.
+        DeferredBodyScope scope(&source);
+        JSONReader        reader(is, offset);
+        return parse_node_of_kind<Block>(reader, source.context, "Block");
+    }
+
+    Block* FunctionDecl::get_body() {
+        if ((this->body == nullptr) and (this->deferred_body_source != nullptr)) {
+            std::lock_guard<std::mutex> lock(this->deferred_body_source->mutex);
+            this->body = parse_deferred_body(
+                *this->deferred_body_source, this->deferred_body_offset);
+        }
+        return this->body;
+    }
+
+    Block* read_ast(const std::string& path, ASTContext& context, const ASTReadOptions& options) {
+        TANGO_TRACE_SCOPE(trace_scope, "read_ast");
+        TANGO_TRACE_DETAIL(trace_scope, path);
+        MemoryCategoryScope memory_scope(mc_json);
+
+        // The mapped file is retained by the context if bodies are deferred,
+        // so that they can be parsed later on.
+        auto source = std::make_shared<DeferredBodySource>(path, context);
+        auto& file  = source->file;
+        const DeferredBodySource* deferred = nullptr;
+        if (options.lazy_bodies) {
+            context.retain(source);
+            deferred = source.get();
+        }
+
+        // Without threads, there is no need to locate the statements first.
+        if (options.thread_count <= 1) {
+            MemoryBuffer      buffer(file.data, file.size);
+            std::istream      is(&buffer);
+            DeferredBodyScope scope(deferred);
+            return read_ast(is, context);
+        }
+
+        ModuleOutline outline      = read_module_outline(file);
+        unsigned      thread_count = options.thread_count;
+
+        // Split the statements in more chunks than threads, so that threads
+        // that get small functions don't sit idle. Chunks only depend on the
+        // number of threads, and are concatenated in order, so the result
+        // doesn't depend on scheduling.
+        auto        statement_count = outline.statements.size();
+        std::size_t chunk_count     = std::min<std::size_t>(
+            statement_count, std::max(thread_count, 1u) * 4);
+        std::size_t chunk_size      = chunk_count > 0
+            ? (statement_count + chunk_count - 1) / chunk_count
+            : 0;
+
+        std::vector<std::vector<ASTNode*>>       chunks(chunk_count);
+        std::vector<std::shared_ptr<ASTContext>> contexts(std::min<std::size_t>(thread_count, chunk_count));
+        std::vector<std::exception_ptr>          errors(contexts.size());
+        std::atomic<std::size_t>                 next_chunk(0);
+        for (auto& worker_context: contexts) {
+            worker_context = std::make_shared<ASTContext>();
+        }
+
+        auto work = [&](std::size_t worker) {
+            try {
+                MemoryCategoryScope memory_scope(mc_json);
+                DeferredBodyScope   scope(deferred);
+                MemoryBuffer        buffer(file.data, file.size);
+                std::istream      is(&buffer);
+
+                std::size_t chunk;
+                while ((chunk = next_chunk.fetch_add(1)) < chunk_count) {
+                    auto begin = chunk * chunk_size;
+                    auto end   = std::min(begin + chunk_size, statement_count);
+                    for (auto i = begin; i < end; ++i) {
+                        buffer.pubseekpos(static_cast<std::streamoff>(outline.statements[i]));
+                        JSONReader reader(is, outline.statements[i]);
+                        chunks[chunk].push_back(parse_node(reader, *contexts[worker]));
+                    }
+                }
+            } catch (...) {
+                errors[worker] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        if (contexts.size() == 1) {
+            work(0);
+        } else {
+            for (std::size_t i = 0; i < contexts.size(); ++i) {
+                threads.push_back(std::thread([&work, i] {
+                    set_thread_memory_category(mc_json);
+                    work(i);
+                }));
+            }
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        for (auto& error: errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
 
-        auto module = ast_data.at("ModuleDecl");
-        return std::unique_ptr<tango::ASTNode>(parse_block(module.at("body").at("Block")));
+        // Merge the arenas of the workers, and build the module's block.
+        // The lists of the nodes still allocate from the context of their
+        // worker if they grow (e.g. capture lists), so the emptied contexts
+        // are kept alive along with the module's.
+        for (auto& worker_context: contexts) {
+            context.adopt(*worker_context);
+            context.retain(worker_context);
+        }
+        auto statements = context.list<ASTNode*>();
+        statements.reserve(statement_count);
+        for (auto& chunk: chunks) {
+            statements.insert(statements.end(), chunk.begin(), chunk.end());
+        }
+
+        auto ret = context.create<Block>(std::move(statements));
+        ret->md_range = outline.range;
+        return ret;
     }
 
 } // namespace tango
@@ -9,12 +9,16 @@
 #pragma once
 
 #include <fstream>
+#include <istream>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "astcontext.hh"
 #include "captureinfo.hh"
+#include "symbol.hh"
 #include "types.hh"
 
 
@@ -28,6 +32,7 @@ namespace tango {
     // Enumerations of operators.
     enum Operator {
         add, sub, mul, div,
+        lt, le, gt, ge, eq, ne,
     };
 
     enum AssignmentOperator {
@@ -36,8 +41,30 @@ namespace tango {
 
     struct ASTNodeVisitor;
 
+    /// A range in the source code of a module, as reported by the frontend.
+    ///
+    /// Lines and columns start at 1. A zero line denotes an unknown range,
+    /// e.g. for nodes that were synthesized rather than parsed.
+    struct SourceRange {
+        SourceRange():
+            start_line(0), start_column(0), end_line(0), end_column(0) {}
+
+        unsigned start_line;
+        unsigned start_column;
+        unsigned end_line;
+        unsigned end_column;
+    };
+
+    struct DeferredBodySource;
+
     /// Base class for all AST nodes.
+    ///
+    /// Nodes are owned by the ASTContext in which they were created, and
+    /// should be created with ASTContext::create. Nodes only refer to
+    /// memory owned by their context or to unique types, so their
+    /// destructors have nothing to release and are never called.
     struct ASTNode {
+        ASTNode(): md_type(nullptr) {}
         virtual ~ASTNode() {};
 
         // Has to be implemented in every derived class, or dynamic dispatch
@@ -45,7 +72,8 @@ namespace tango {
         virtual void accept(ASTNodeVisitor& visitor) = 0;
 
         // Following are metadata about AST nodes.
-        TypePtr md_type;
+        TypePtr     md_type;
+        SourceRange md_range;
 
         // Following are helpers to create ASTs inline.
         ASTNode* set_type(TypePtr type) {
@@ -63,10 +91,8 @@ namespace tango {
 
     /// AST node for blocks of instructions.
     struct Block: public ASTNode {
-        Block(const std::vector<ASTNode*> statements):
-            statements(statements) {}
-
-        ~Block();
+        Block(ASTVector<ASTNode*> statements):
+            statements(std::move(statements)) {}
 
         void accept(ASTNodeVisitor& visitor);
 
@@ -74,34 +100,39 @@ namespace tango {
             throw std::invalid_argument("Block nodes have no name.");
         };
 
-        std::vector<ASTNode*> statements;
+        ASTVector<ASTNode*> statements;
     };
 
     /// Virtual class for AST declaration nodes.
     struct Decl: public ASTNode {
-        Decl(const std::string& name): name(name) {}
+        Decl(Symbol name): name(name) {}
 
         virtual ~Decl() {};
 
-        std::string name;
+        Symbol name;
     };
 
     /// AST node for property declarations.
     struct PropertyDecl: public Decl {
         PropertyDecl(
-            const std::string&   name,
+            Symbol               name,
             IdentifierMutability im = im_cst):
-            Decl(name), mutability(im) {}
+            Decl(name), mutability(im), is_initialized_before_capture(false) {}
 
         void accept(ASTNodeVisitor& visitor);
 
         IdentifierMutability mutability;
+
+        /// Whether the property is assigned by a statement of the block
+        /// declaring it before any nested function captures it, as computed
+        /// by analysis::compute_capture_lists.
+        bool is_initialized_before_capture;
     };
 
     /// AST node for function parameters.
     struct ParamDecl: public Decl {
         ParamDecl(
-            const std::string&   name,
+            Symbol               name,
             IdentifierMutability im = im_cst):
             Decl(name), mutability(im) {}
 
@@ -113,20 +144,56 @@ namespace tango {
     /// AST node for function declarations.
     struct FunctionDecl: public Decl {
         FunctionDecl(
-            const std::string&                name,
-            const std::vector<ParamDecl*>&    parameters,
-            Block*                            body):
-            Decl(name), parameters(parameters), body(body) {}
-
-        ~FunctionDecl();
+            Symbol                 name,
+            ASTVector<ParamDecl*>  parameters,
+            Block*                 body):
+            Decl(name),
+            parameters(std::move(parameters)),
+            body(body),
+            deferred_body_source(nullptr),
+            deferred_body_offset(0),
+            capture_list(this->parameters.get_allocator()),
+            is_reachable(true),
+            is_liftable(false) {}
 
         void accept(ASTNodeVisitor& visitor);
 
-        std::vector<ParamDecl*> parameters;
-        Block*                  body;
+        /// Returns the body of the function.
+        ///
+        /// If the loader deferred the body, it is parsed the first time it is
+        /// requested, in the context of the AST. Bodies of different functions
+        /// may be requested from several threads at once, but the body of a
+        /// given function may not.
+        Block* get_body();
+
+        /// Returns whether the body of the function is yet to be parsed.
+        bool has_deferred_body() const {
+            return (this->body == nullptr) and (this->deferred_body_source != nullptr);
+        }
+
+        ASTVector<ParamDecl*> parameters;
+
+        /// The body of the function, or nullptr if it is deferred.
+        Block*                body;
+
+        /// The file and offset from which to parse a deferred body.
+        const DeferredBodySource* deferred_body_source;
+        std::size_t               deferred_body_offset;
 
         /// Lists the local captures of the function.
-        std::vector<CapturedValue> capture_list;
+        ASTVector<CapturedValue> capture_list;
+
+        /// Whether the function may be called by the program, as determined
+        /// by analysis::mark_reachable_functions. Unreachable functions are
+        /// skipped by the IR generator.
+        bool is_reachable;
+
+        /// Whether the nested function is only ever called directly by the
+        /// function that declares it, as determined by
+        /// analysis::compute_capture_lists. Such functions aren't recursive
+        /// and don't escape, so the IR generator lifts them to functions
+        /// that take their captures as parameters, without a closure.
+        bool is_liftable;
     };
 
     // AST node for assignments.
@@ -137,8 +204,6 @@ namespace tango {
             ASTNode*           rvalue):
             lvalue(lvalue), op(op), rvalue(rvalue) {}
 
-        ~Assignment();
-
         void accept(ASTNodeVisitor& visitor);
 
         ASTNode*           lvalue;
@@ -154,8 +219,6 @@ namespace tango {
             Block*   else_block):
             condition(condition), then_block(then_block), else_block(else_block) {}
 
-        ~If();
-
         void accept(ASTNodeVisitor& visitor);
 
         ASTNode* condition;
@@ -167,8 +230,6 @@ namespace tango {
     struct Return: public ASTNode {
         Return(ASTNode* value): value(value) {}
 
-        ~Return();
-
         void accept(ASTNodeVisitor& visitor);
 
         ASTNode* value;
@@ -182,8 +243,6 @@ namespace tango {
             Operator op):
             left(left), right(right), op(op) {}
 
-        ~BinaryExpr();
-
         void accept(ASTNodeVisitor& visitor);
 
         ASTNode* left;
@@ -194,16 +253,14 @@ namespace tango {
     // AST node for call arguments.
     struct CallArg: public ASTNode {
         CallArg(
-            const std::string& label,
+            Symbol             label,
             AssignmentOperator op,
             ASTNode*           value):
             label(label), op(op), value(value) {}
 
-        ~CallArg();
-
         void accept(ASTNodeVisitor& visitor);
 
-        std::string        label;
+        Symbol             label;
         AssignmentOperator op;
         ASTNode*           value;
     };
@@ -211,25 +268,23 @@ namespace tango {
     /// AST node for call expressions.
     struct Call: public ASTNode {
         Call(
-            ASTNode*                     callee,
-            const std::vector<CallArg*>& arguments):
-            callee(callee), arguments(arguments) {}
-
-        ~Call();
+            ASTNode*            callee,
+            ASTVector<CallArg*> arguments):
+            callee(callee), arguments(std::move(arguments)) {}
 
         void accept(ASTNodeVisitor& visitor);
 
-        ASTNode* callee;
-        std::vector<CallArg*> arguments;
+        ASTNode*            callee;
+        ASTVector<CallArg*> arguments;
     };
 
     /// AST node for identifiers.
     struct Identifier: public ASTNode {
-        Identifier(const std::string& name): name(name) {}
+        Identifier(Symbol name): name(name) {}
 
         void accept(ASTNodeVisitor& visitor);
 
-        std::string name;
+        Symbol name;
     };
 
     /// AST node for integer literals.
@@ -266,6 +321,31 @@ namespace tango {
         virtual void visit(BooleanLiteral& node) = 0;
     };
 
-    std::unique_ptr<tango::ASTNode> read_ast(std::ifstream&);
+    /// Builds the AST of a module from its JSON representation, without ever
+    /// holding the whole JSON document in memory.
+    ///
+    /// The nodes of the AST are allocated in the given context.
+    Block* read_ast(std::istream&, ASTContext&);
+
+    /// Options of the JSON AST loader.
+    struct ASTReadOptions {
+        ASTReadOptions(): thread_count(1), lazy_bodies(false) {}
+
+        /// Number of threads parsing the top-level statements of the module.
+        ///
+        /// Statements are split in chunks, parsed by a pool of threads in
+        /// arenas of their own, which are merged in the given context once
+        /// done. The resulting AST doesn't depend on the number of threads.
+        unsigned thread_count;
+
+        /// Whether to defer the parsing of function bodies until they are
+        /// first requested with FunctionDecl::get_body.
+        ///
+        /// The input file then stays mapped in memory as long as the context.
+        bool lazy_bodies;
+    };
+
+    /// Builds the AST of a module from the JSON file at the given path.
+    Block* read_ast(const std::string& path, ASTContext&, const ASTReadOptions& = ASTReadOptions());
 
 } // namespace tango
@@ -0,0 +1,642 @@
+//
+//  astbinary.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "astbinary.hh"
+#include "mappedfile.hh"
+#include "types.hh"
+
+
+namespace tango {
+
+    static const char binary_ast_magic[4] = {'T', 'A', 'S', 'T'};
+
+    /// Sentinel index for absent types.
+    static const std::uint32_t no_type = 0xFFFFFFFF;
+
+    enum BinaryTypeKind: std::uint8_t {
+        btk_int, btk_bool, btk_ref, btk_function,
+    };
+
+    enum BinaryNodeKind: std::uint8_t {
+        bnk_block, bnk_prop_decl, bnk_param_decl, bnk_fun_decl, bnk_assignment, bnk_if,
+        bnk_return, bnk_binary_expr, bnk_call, bnk_call_arg, bnk_identifier, bnk_int_literal,
+        bnk_bool_literal,
+    };
+
+    // -----------------------------------------------------------------------
+
+    /// Visitor that serializes the nodes of an AST in post-order.
+    ///
+    /// Each node record starts with its kind, an attribute byte (mutability,
+    /// operator, ...), two bytes of padding, the index of its type and its
+    /// source range, followed by its kind-specific payload.
+    struct BinaryASTWriter: public ASTNodeVisitor {
+
+        void visit(Block& node) {
+            std::vector<std::uint32_t> children;
+            for (auto statement: node.statements) {
+                children.push_back(this->emit(*statement));
+            }
+
+            this->begin_record(node, bnk_block);
+            this->put_list(children);
+        }
+
+        void visit(PropertyDecl& node) {
+            this->begin_record(node, bnk_prop_decl, node.mutability);
+            this->put_u32(this->intern(node.name.str()));
+            this->decls[&node] = this->node_count;
+        }
+
+        void visit(ParamDecl& node) {
+            this->begin_record(node, bnk_param_decl, node.mutability);
+            this->put_u32(this->intern(node.name.str()));
+            this->decls[&node] = this->node_count;
+        }
+
+        void visit(FunctionDecl& node) {
+            std::vector<std::uint32_t> parameters;
+            for (auto parameter: node.parameters) {
+                parameters.push_back(this->emit(*parameter));
+            }
+            auto body = this->emit(*node.get_body());
+
+            this->begin_record(node, bnk_fun_decl);
+            this->decls[&node] = this->node_count;
+            this->put_u32(this->intern(node.name.str()));
+            this->put_list(parameters);
+            this->put_u32(body);
+
+            // Captured declarations necessarily appear before the function
+            // that captures them, so they already have an index.
+            this->put_u32(static_cast<std::uint32_t>(node.capture_list.size()));
+            for (auto& capture: node.capture_list) {
+                auto it = this->decls.find(capture.decl);
+                if (it == this->decls.end()) {
+                    throw std::invalid_argument("capture of an undeclared symbol");
+                }
+                this->put_u32(it->second);
+                this->put_u32(capture.is_noescape ? 1 : 0);
+            }
+        }
+
+        void visit(Assignment& node) {
+            auto lvalue = this->emit(*node.lvalue);
+            auto rvalue = this->emit(*node.rvalue);
+
+            this->begin_record(node, bnk_assignment, node.op);
+            this->put_u32(lvalue);
+            this->put_u32(rvalue);
+        }
+
+        void visit(If& node) {
+            auto condition  = this->emit(*node.condition);
+            auto then_block = this->emit(*node.then_block);
+            auto else_block = this->emit(*node.else_block);
+
+            this->begin_record(node, bnk_if);
+            this->put_u32(condition);
+            this->put_u32(then_block);
+            this->put_u32(else_block);
+        }
+
+        void visit(Return& node) {
+            auto value = this->emit(*node.value);
+
+            this->begin_record(node, bnk_return);
+            this->put_u32(value);
+        }
+
+        void visit(BinaryExpr& node) {
+            auto left  = this->emit(*node.left);
+            auto right = this->emit(*node.right);
+
+            this->begin_record(node, bnk_binary_expr, node.op);
+            this->put_u32(left);
+            this->put_u32(right);
+        }
+
+        void visit(Call& node) {
+            auto callee = this->emit(*node.callee);
+            std::vector<std::uint32_t> arguments;
+            for (auto argument: node.arguments) {
+                arguments.push_back(this->emit(*argument));
+            }
+
+            this->begin_record(node, bnk_call);
+            this->put_u32(callee);
+            this->put_list(arguments);
+        }
+
+        void visit(CallArg& node) {
+            auto value = this->emit(*node.value);
+
+            this->begin_record(node, bnk_call_arg, node.op);
+            this->put_u32(this->intern(node.label.str()));
+            this->put_u32(value);
+        }
+
+        void visit(Identifier& node) {
+            this->begin_record(node, bnk_identifier);
+            this->put_u32(this->intern(node.name.str()));
+        }
+
+        void visit(IntegerLiteral& node) {
+            this->begin_record(node, bnk_int_literal);
+            this->put_u32(static_cast<std::uint32_t>(node.value));
+        }
+
+        void visit(BooleanLiteral& node) {
+            this->begin_record(node, bnk_bool_literal, node.value ? 1 : 0);
+        }
+
+        /// Serializes a node and returns its index in the node table.
+        std::uint32_t emit(ASTNode& node) {
+            node.accept(*this);
+            return this->node_count++;
+        }
+
+        void begin_record(ASTNode& node, BinaryNodeKind kind, std::uint8_t attr = 0) {
+            this->nodes.push_back(kind);
+            this->nodes.push_back(attr);
+            this->nodes.push_back(0);
+            this->nodes.push_back(0);
+            this->put_u32(this->intern(node.md_type));
+            this->put_u32(node.md_range.start_line);
+            this->put_u32(node.md_range.start_column);
+            this->put_u32(node.md_range.end_line);
+            this->put_u32(node.md_range.end_column);
+        }
+
+        void put_u32(std::uint32_t value) {
+            put_u32(this->nodes, value);
+        }
+
+        void put_list(const std::vector<std::uint32_t>& values) {
+            this->put_u32(static_cast<std::uint32_t>(values.size()));
+            for (auto value: values) {
+                this->put_u32(value);
+            }
+        }
+
+        static void put_u32(std::vector<std::uint8_t>& out, std::uint32_t value) {
+            out.push_back(static_cast<std::uint8_t>(value));
+            out.push_back(static_cast<std::uint8_t>(value >> 8));
+            out.push_back(static_cast<std::uint8_t>(value >> 16));
+            out.push_back(static_cast<std::uint8_t>(value >> 24));
+        }
+
+        std::uint32_t intern(const std::string& str) {
+            auto it = this->string_indices.find(str);
+            if (it != this->string_indices.end()) {
+                return it->second;
+            }
+
+            auto idx = static_cast<std::uint32_t>(this->strings.size());
+            this->strings.push_back(str);
+            this->string_indices[str] = idx;
+            return idx;
+        }
+
+        /// Interns a type, making sure each type is stored only once in the
+        /// type table. As types are unique, they are identified by address.
+        std::uint32_t intern(TypePtr type) {
+            if (type == nullptr) {
+                return no_type;
+            }
+
+            auto it = this->type_indices.find(type);
+            if (it != this->type_indices.end()) {
+                return it->second;
+            }
+
+            // Serialize the type, after its components.
+            std::vector<std::uint8_t> record;
+            if (auto ref_type = dynamic_cast<const RefType*>(type)) {
+                auto referred = this->intern(ref_type->referred_type);
+                record.push_back(btk_ref);
+                put_u32(record, referred);
+            } else if (auto fun_type = dynamic_cast<const FunctionType*>(type)) {
+                std::vector<std::uint32_t> domain;
+                for (auto ty: fun_type->domain) {
+                    domain.push_back(this->intern(ty));
+                }
+                auto codomain = this->intern(fun_type->codomain);
+
+                record.push_back(btk_function);
+                put_u32(record, static_cast<std::uint32_t>(domain.size()));
+                for (std::size_t i = 0; i < domain.size(); ++i) {
+                    put_u32(record, domain[i]);
+                    put_u32(record, this->intern(fun_type->labels[i].str()));
+                }
+                put_u32(record, codomain);
+            } else if (dynamic_cast<const BoolType*>(type)) {
+                record.push_back(btk_bool);
+            } else if (dynamic_cast<const IntType*>(type)) {
+                record.push_back(btk_int);
+            } else {
+                throw std::invalid_argument("type cannot be serialized");
+            }
+
+            auto idx = this->type_count++;
+            this->types.insert(this->types.end(), record.begin(), record.end());
+            this->type_indices[type] = idx;
+            return idx;
+        }
+
+        std::vector<std::string>                        strings;
+        std::unordered_map<std::string, std::uint32_t>  string_indices;
+
+        std::vector<std::uint8_t>                       types;
+        std::unordered_map<TypePtr, std::uint32_t>      type_indices;
+        std::uint32_t                                   type_count = 0;
+
+        std::vector<std::uint8_t>                       nodes;
+        std::unordered_map<Decl*, std::uint32_t>        decls;
+        std::uint32_t                                   node_count = 0;
+
+    };
+
+
+    void write_binary_ast(Block& module, std::ostream& os) {
+        BinaryASTWriter writer;
+        auto root = writer.emit(module);
+
+        // Layout the string table as an array of offsets into a blob, so
+        // that strings can be accessed in constant time.
+        std::vector<std::uint8_t> strings;
+        std::uint32_t             offset = 0;
+        for (auto& str: writer.strings) {
+            BinaryASTWriter::put_u32(strings, offset);
+            offset += static_cast<std::uint32_t>(str.size());
+        }
+        BinaryASTWriter::put_u32(strings, offset);
+        for (auto& str: writer.strings) {
+            strings.insert(strings.end(), str.begin(), str.end());
+        }
+
+        // Write the header.
+        std::vector<std::uint8_t> header(binary_ast_magic, binary_ast_magic + 4);
+        BinaryASTWriter::put_u32(header, binary_ast_version);
+        BinaryASTWriter::put_u32(header, static_cast<std::uint32_t>(writer.strings.size()));
+        BinaryASTWriter::put_u32(header, static_cast<std::uint32_t>(strings.size()));
+        BinaryASTWriter::put_u32(header, writer.type_count);
+        BinaryASTWriter::put_u32(header, static_cast<std::uint32_t>(writer.types.size()));
+        BinaryASTWriter::put_u32(header, writer.node_count);
+        BinaryASTWriter::put_u32(header, static_cast<std::uint32_t>(writer.nodes.size()));
+        BinaryASTWriter::put_u32(header, root);
+
+        for (auto section: {&header, &strings, &writer.types, &writer.nodes}) {
+            os.write(reinterpret_cast<const char*>(section->data()), section->size());
+        }
+        if (!os) {
+            throw std::runtime_error("failed to write binary AST");
+        }
+    }
+
+    // -----------------------------------------------------------------------
+
+    /// Cursor over a section of a mapped binary AST file.
+    struct BinaryCursor {
+
+        BinaryCursor(const std::uint8_t* begin, const std::uint8_t* end):
+            ptr(begin), end(end) {}
+
+        std::uint8_t get_u8() {
+            this->require(1);
+            return *this->ptr++;
+        }
+
+        std::uint32_t get_u32() {
+            this->require(4);
+            std::uint32_t ret =
+                static_cast<std::uint32_t>(this->ptr[0])         |
+                (static_cast<std::uint32_t>(this->ptr[1]) << 8)  |
+                (static_cast<std::uint32_t>(this->ptr[2]) << 16) |
+                (static_cast<std::uint32_t>(this->ptr[3]) << 24);
+            this->ptr += 4;
+            return ret;
+        }
+
+        void skip(std::size_t n) {
+            this->require(n);
+            this->ptr += n;
+        }
+
+        void require(std::size_t n) const {
+            if (static_cast<std::size_t>(this->end - this->ptr) < n) {
+                throw std::invalid_argument("truncated binary AST");
+            }
+        }
+
+        const std::uint8_t* ptr;
+        const std::uint8_t* end;
+
+    };
+
+
+    /// Materializes the nodes of a mapped binary AST file.
+    struct BinaryASTReader {
+
+        BinaryASTReader(const MappedFile& file, ASTContext& context):
+            cursor(file.data, file.data + file.size), context(context)
+        {
+            const std::size_t header_size = 36;
+            this->cursor.require(header_size);
+            if (std::memcmp(file.data, binary_ast_magic, 4) != 0) {
+                throw std::invalid_argument("not a binary AST file");
+            }
+            this->cursor.skip(4);
+            if (this->cursor.get_u32() != binary_ast_version) {
+                throw std::invalid_argument("unsupported binary AST version");
+            }
+
+            auto string_count  = this->cursor.get_u32();
+            auto strings_size  = this->cursor.get_u32();
+            auto type_count    = this->cursor.get_u32();
+            auto types_size    = this->cursor.get_u32();
+            auto node_count    = this->cursor.get_u32();
+            auto nodes_size    = this->cursor.get_u32();
+            this->root         = this->cursor.get_u32();
+
+            // Locate the string table. Strings are materialized lazily.
+            this->cursor.require(strings_size);
+            this->string_offsets = BinaryCursor(this->cursor.ptr, this->cursor.ptr + strings_size);
+            this->string_count   = string_count;
+            this->symbols.resize(string_count);
+            this->symbols_set.resize(string_count, false);
+            this->string_data    = this->cursor.ptr + 4 * (std::size_t(string_count) + 1);
+            if (4 * (std::size_t(string_count) + 1) > strings_size) {
+                throw std::invalid_argument("corrupted binary AST string table");
+            }
+            this->cursor.skip(strings_size);
+
+            // Materialize the types, which are few.
+            this->cursor.require(types_size);
+            BinaryCursor types(this->cursor.ptr, this->cursor.ptr + types_size);
+            this->types.reserve(type_count);
+            for (std::uint32_t i = 0; i < type_count; ++i) {
+                this->types.push_back(this->read_type(types));
+            }
+            this->cursor.skip(types_size);
+
+            this->cursor.require(nodes_size);
+            this->cursor.end = this->cursor.ptr + nodes_size;
+            this->nodes.reserve(node_count);
+            this->node_count = node_count;
+        }
+
+        Block* read_module() {
+            for (std::uint32_t i = 0; i < this->node_count; ++i) {
+                this->nodes.push_back(this->read_node());
+            }
+
+            auto module = dynamic_cast<Block*>(this->node(this->root));
+            if (module == nullptr) {
+                throw std::invalid_argument("binary AST root is not a block");
+            }
+            return module;
+        }
+
+        std::string string(std::uint32_t idx) const {
+            if (idx >= this->string_count) {
+                throw std::invalid_argument("invalid string index in binary AST");
+            }
+
+            BinaryCursor offsets(this->string_offsets.ptr + 4 * idx, this->string_offsets.end);
+            auto begin = offsets.get_u32();
+            auto end   = offsets.get_u32();
+            if ((end < begin) or (this->string_data + end > this->string_offsets.end)) {
+                throw std::invalid_argument("corrupted binary AST string table");
+            }
+            return std::string(
+                reinterpret_cast<const char*>(this->string_data) + begin, end - begin);
+        }
+
+        /// Returns the symbol of a string of the string table, interning the
+        /// string the first time it is requested.
+        Symbol symbol(std::uint32_t idx) {
+            if (idx >= this->string_count) {
+                throw std::invalid_argument("invalid string index in binary AST");
+            }
+            if (!this->symbols_set[idx]) {
+                this->symbols[idx]     = Symbol(this->string(idx));
+                this->symbols_set[idx] = true;
+            }
+            return this->symbols[idx];
+        }
+
+        TypePtr type(std::uint32_t idx) const {
+            if (idx == no_type) {
+                return nullptr;
+            }
+            if (idx >= this->types.size()) {
+                throw std::invalid_argument("invalid type index in binary AST");
+            }
+            return this->types[idx];
+        }
+
+        ASTNode* node(std::uint32_t idx) const {
+            if (idx >= this->nodes.size()) {
+                throw std::invalid_argument("invalid node index in binary AST");
+            }
+            return this->nodes[idx];
+        }
+
+        template<typename T>
+        T* node_of_kind(std::uint32_t idx) const {
+            auto ret = dynamic_cast<T*>(this->node(idx));
+            if (ret == nullptr) {
+                throw std::invalid_argument("unexpected node kind in binary AST");
+            }
+            return ret;
+        }
+
+        TypePtr read_type(BinaryCursor& types) {
+            switch (types.get_u8()) {
+                case btk_int:
+                    return IntType::get();
+                case btk_bool:
+                    return BoolType::get();
+                case btk_ref:
+                    return RefType::get(this->type(types.get_u32()));
+                case btk_function: {
+                    auto                 arity = types.get_u32();
+                    std::vector<TypePtr> domain;
+                    std::vector<Symbol>  labels;
+                    for (std::uint32_t i = 0; i < arity; ++i) {
+                        domain.push_back(this->type(types.get_u32()));
+                        labels.push_back(this->symbol(types.get_u32()));
+                    }
+                    return FunctionType::get(domain, labels, this->type(types.get_u32()));
+                }
+                default:
+                    throw std::invalid_argument("unknown type kind in binary AST");
+            }
+        }
+
+        ASTNode* read_node() {
+            auto kind = this->cursor.get_u8();
+            auto attr = this->cursor.get_u8();
+            this->cursor.skip(2);
+            auto        type = this->type(this->cursor.get_u32());
+            SourceRange range;
+            range.start_line   = this->cursor.get_u32();
+            range.start_column = this->cursor.get_u32();
+            range.end_line     = this->cursor.get_u32();
+            range.end_column   = this->cursor.get_u32();
+
+            ASTNode* ret;
+            switch (kind) {
+                case bnk_block: {
+                    auto statements = this->context.list<ASTNode*>();
+                    statements.resize(this->cursor.get_u32());
+                    for (auto& statement: statements) {
+                        statement = this->node(this->cursor.get_u32());
+                    }
+                    ret = this->context.create<Block>(std::move(statements));
+                    break;
+                }
+
+                case bnk_prop_decl:
+                    ret = this->context.create<PropertyDecl>(
+                        this->symbol(this->cursor.get_u32()),
+                        static_cast<IdentifierMutability>(attr));
+                    break;
+
+                case bnk_param_decl:
+                    ret = this->context.create<ParamDecl>(
+                        this->symbol(this->cursor.get_u32()),
+                        static_cast<IdentifierMutability>(attr));
+                    break;
+
+                case bnk_fun_decl: {
+                    auto name = this->symbol(this->cursor.get_u32());
+                    auto parameters = this->context.list<ParamDecl*>();
+                    parameters.resize(this->cursor.get_u32());
+                    for (auto& parameter: parameters) {
+                        parameter = this->node_of_kind<ParamDecl>(this->cursor.get_u32());
+                    }
+                    auto body = this->node_of_kind<Block>(this->cursor.get_u32());
+
+                    auto fun_decl = this->context.create<FunctionDecl>(
+                        name, std::move(parameters), body);
+                    auto capture_count = this->cursor.get_u32();
+                    for (std::uint32_t i = 0; i < capture_count; ++i) {
+                        auto decl        = this->node_of_kind<Decl>(this->cursor.get_u32());
+                        auto is_noescape = this->cursor.get_u32() != 0;
+                        fun_decl->capture_list.push_back(CapturedValue(decl, is_noescape));
+                    }
+                    ret = fun_decl;
+                    break;
+                }
+
+                case bnk_assignment: {
+                    auto lvalue = this->node(this->cursor.get_u32());
+                    auto rvalue = this->node(this->cursor.get_u32());
+                    ret = this->context.create<Assignment>(
+                        lvalue, static_cast<AssignmentOperator>(attr), rvalue);
+                    break;
+                }
+
+                case bnk_if: {
+                    auto condition  = this->node(this->cursor.get_u32());
+                    auto then_block = this->node_of_kind<Block>(this->cursor.get_u32());
+                    auto else_block = this->node_of_kind<Block>(this->cursor.get_u32());
+                    ret = this->context.create<If>(condition, then_block, else_block);
+                    break;
+                }
+
+                case bnk_return:
+                    ret = this->context.create<Return>(this->node(this->cursor.get_u32()));
+                    break;
+
+                case bnk_binary_expr: {
+                    auto left  = this->node(this->cursor.get_u32());
+                    auto right = this->node(this->cursor.get_u32());
+                    ret = this->context.create<BinaryExpr>(
+                        left, right, static_cast<Operator>(attr));
+                    break;
+                }
+
+                case bnk_call: {
+                    auto callee = this->node(this->cursor.get_u32());
+                    auto arguments = this->context.list<CallArg*>();
+                    arguments.resize(this->cursor.get_u32());
+                    for (auto& argument: arguments) {
+                        argument = this->node_of_kind<CallArg>(this->cursor.get_u32());
+                    }
+                    ret = this->context.create<Call>(callee, std::move(arguments));
+                    break;
+                }
+
+                case bnk_call_arg: {
+                    auto label = this->symbol(this->cursor.get_u32());
+                    auto value = this->node(this->cursor.get_u32());
+                    ret = this->context.create<CallArg>(
+                        label, static_cast<AssignmentOperator>(attr), value);
+                    break;
+                }
+
+                case bnk_identifier:
+                    ret = this->context.create<Identifier>(
+                        this->symbol(this->cursor.get_u32()));
+                    break;
+
+                case bnk_int_literal:
+                    ret = this->context.create<IntegerLiteral>(
+                        static_cast<int>(this->cursor.get_u32()));
+                    break;
+
+                case bnk_bool_literal:
+                    ret = this->context.create<BooleanLiteral>(attr != 0);
+                    break;
+
+                default:
+                    throw std::invalid_argument("unknown node kind in binary AST");
+            }
+
+            ret->md_type  = type;
+            ret->md_range = range;
+            return ret;
+        }
+
+        BinaryCursor          cursor;
+        ASTContext&           context;
+        BinaryCursor          string_offsets = BinaryCursor(nullptr, nullptr);
+        const std::uint8_t*   string_data    = nullptr;
+        std::uint32_t         string_count   = 0;
+        std::vector<Symbol>   symbols;
+        std::vector<bool>     symbols_set;
+        std::vector<TypePtr>  types;
+        std::vector<ASTNode*> nodes;
+        std::uint32_t         node_count     = 0;
+        std::uint32_t         root           = 0;
+
+    };
+
+
+    Block* read_binary_ast(const std::string& path, ASTContext& context) {
+        MappedFile      file(path);
+        BinaryASTReader reader(file, context);
+        return reader.read_module();
+    }
+
+
+    bool is_binary_ast(const std::string& path) {
+        std::ifstream ifs(path, std::ios::binary);
+        char magic[4];
+        return ifs.read(magic, 4) and (std::memcmp(magic, binary_ast_magic, 4) == 0);
+    }
+
+} // namespace tango
@@ -0,0 +1,41 @@
+//
+//  astbinary.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "ast.hh"
+
+
+namespace tango {
+
+    /// Version of the binary AST format produced by write_binary_ast.
+    ///
+    /// It should be bumped every time the layout of the file changes, as the
+    /// loader refuses files of other versions.
+    const std::uint32_t binary_ast_version = 1;
+
+    /// Writes the binary representation of a module's AST.
+    ///
+    /// A binary AST file is made of a header, followed by a table of
+    /// interned strings, a table of types, and a table of nodes. Nodes are
+    /// stored in post-order, so that children always precede their parents
+    /// and are referred to by their index in the node table. All integers
+    /// are 32-bit little endian.
+    void write_binary_ast(Block& module, std::ostream& os);
+
+    /// Maps a binary AST file in memory and materializes the AST it contains
+    /// in the given context.
+    Block* read_binary_ast(const std::string& path, ASTContext& context);
+
+    /// Returns whether the file at the given path is a binary AST file.
+    bool is_binary_ast(const std::string& path);
+
+} // namespace tango
@@ -0,0 +1,70 @@
+//
+//  astcontext.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include "allocstats.hh"
+#include "astcontext.hh"
+
+
+namespace tango {
+
+    /// Size of the slabs of the arena.
+    static const std::size_t slab_size = 64 * 1024;
+
+    /// Allocations larger than this threshold get a slab of their own, so
+    /// that they don't waste the remainder of the current one.
+    static const std::size_t large_allocation_size = slab_size / 4;
+
+
+    ASTContext::ASTContext():
+        current(nullptr), current_size(0), cursor(0), reserved(0) {}
+
+
+    ASTContext::~ASTContext() {
+        MemoryCategoryScope memory_scope(mc_ast);
+        for (auto slab: this->slabs) {
+            ::operator delete(slab);
+        }
+    }
+
+
+    void ASTContext::adopt(ASTContext& other) {
+        MemoryCategoryScope memory_scope(mc_ast);
+        this->slabs.insert(this->slabs.end(), other.slabs.begin(), other.slabs.end());
+        this->reserved += other.reserved;
+        this->resources.insert(
+            this->resources.end(), other.resources.begin(), other.resources.end());
+
+        other.slabs.clear();
+        other.resources.clear();
+        other.current      = nullptr;
+        other.current_size = 0;
+        other.cursor       = 0;
+        other.reserved     = 0;
+    }
+
+
+    void* ASTContext::allocate_slow(std::size_t size, std::size_t alignment) {
+        MemoryCategoryScope memory_scope(mc_ast);
+
+        // Slabs are allocated with operator new, so they are suitably aligned
+        // for any fundamental type.
+        if (size + alignment > large_allocation_size) {
+            auto slab = static_cast<char*>(::operator new(size));
+            this->slabs.push_back(slab);
+            this->reserved += size;
+            return slab;
+        }
+
+        this->current      = static_cast<char*>(::operator new(slab_size));
+        this->current_size = slab_size;
+        this->cursor       = size;
+        this->slabs.push_back(this->current);
+        this->reserved += slab_size;
+        return this->current;
+    }
+
+} // namespace tango
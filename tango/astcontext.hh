@@ -0,0 +1,136 @@
+//
+//  astcontext.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace tango {
+
+    struct ASTContext;
+
+    /// STL allocator that places its allocations in the arena of an
+    /// ASTContext.
+    ///
+    /// Memory is never given back before the context is destroyed, hence
+    /// deallocate is a no-op.
+    template<typename T>
+    struct ArenaAllocator {
+        typedef T value_type;
+
+        ArenaAllocator(ASTContext& context): context(&context) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other): context(other.context) {}
+
+        T* allocate(std::size_t n);
+        void deallocate(T*, std::size_t) {}
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const {
+            return this->context == other.context;
+        }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const {
+            return this->context != other.context;
+        }
+
+        ASTContext* context;
+    };
+
+    /// Vector type for the children of AST nodes.
+    template<typename T>
+    using ASTVector = std::vector<T, ArenaAllocator<T>>;
+
+    /// Owns the nodes of an AST, and the memory they're placed in.
+    ///
+    /// Nodes are bump-allocated in large slabs, so that nodes built one
+    /// after the other lie contiguously in memory. Nodes own no resource
+    /// outside of the arena, so destroying the context simply releases the
+    /// slabs, without visiting nor freeing nodes one by one.
+    struct ASTContext {
+
+        ASTContext();
+        ASTContext(const ASTContext&) = delete;
+        ~ASTContext();
+
+        /// Creates a node in the arena of the context.
+        template<typename T, typename... Args>
+        T* create(Args&&... args) {
+            void* mem = this->allocate(sizeof(T), alignof(T));
+            return new (mem) T(std::forward<Args>(args)...);
+        }
+
+        /// Copies a list of children in the arena of the context.
+        template<typename T>
+        ASTVector<T> list(const std::vector<T>& elements) {
+            return ASTVector<T>(elements.begin(), elements.end(), ArenaAllocator<T>(*this));
+        }
+
+        /// Returns an empty list of children, allocated in the arena.
+        template<typename T>
+        ASTVector<T> list() {
+            return ASTVector<T>(ArenaAllocator<T>(*this));
+        }
+
+        /// Allocates raw memory in the arena of the context.
+        void* allocate(std::size_t size, std::size_t alignment) {
+            std::size_t offset = (this->cursor + alignment - 1) & ~(alignment - 1);
+            if ((this->current == nullptr) or (offset + size > this->current_size)) {
+                return this->allocate_slow(size, alignment);
+            }
+            this->cursor = offset + size;
+            return this->current + offset;
+        }
+
+        /// Takes the ownership of the nodes of another context, which is left
+        /// empty. Nodes are not moved, so pointers to them remain valid.
+        void adopt(ASTContext& other);
+
+        /// Keeps a resource alive as long as the context, such as the file
+        /// from which deferred nodes are parsed, or a context whose nodes may
+        /// still allocate from its arena.
+        void retain(std::shared_ptr<void> resource) {
+            this->resources.push_back(std::move(resource));
+        }
+
+        /// Returns the number of bytes reserved by the arena.
+        std::size_t get_reserved_bytes() const { return this->reserved; }
+
+    private:
+
+        void* allocate_slow(std::size_t size, std::size_t alignment);
+
+        /// The slabs of the arena.
+        std::vector<char*> slabs;
+
+        /// The slab in which we are currently allocating, with its size and
+        /// the offset of its first free byte.
+        char*       current;
+        std::size_t current_size;
+        std::size_t cursor;
+
+        std::size_t reserved;
+
+        /// The resources retained by the context.
+        std::vector<std::shared_ptr<void>> resources;
+
+    };
+
+    template<typename T>
+    T* ArenaAllocator<T>::allocate(std::size_t n) {
+        return static_cast<T*>(this->context->allocate(n * sizeof(T), alignof(T)));
+    }
+
+} // namespace tango
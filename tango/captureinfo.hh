@@ -23,7 +23,8 @@ namespace tango {
         /// Points to the declaration being captured.
         Decl* decl;
 
-        /// Set when a PropertyDecl is captured by a noescape closure.
+        /// Set when a PropertyDecl is captured by a noescape closure, as
+        /// determined by analysis::mark_escaping_closures.
         bool is_noescape;
 
     };
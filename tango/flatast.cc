@@ -0,0 +1,440 @@
+//
+//  flatast.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include "flatast.hh"
+
+
+namespace tango {
+
+    /// Calls a function with the table of the given kind.
+    template<typename AST, typename F>
+    static auto with_table(AST& ast, FlatNodeKind kind, F f)
+        -> decltype(f(ast.template table<FlatBlock>()))
+    {
+        switch (kind) {
+            case fnk_block:        return f(ast.template table<FlatBlock>());
+            case fnk_prop_decl:    return f(ast.template table<FlatPropertyDecl>());
+            case fnk_param_decl:   return f(ast.template table<FlatParamDecl>());
+            case fnk_fun_decl:     return f(ast.template table<FlatFunctionDecl>());
+            case fnk_assignment:   return f(ast.template table<FlatAssignment>());
+            case fnk_if:           return f(ast.template table<FlatIf>());
+            case fnk_return:       return f(ast.template table<FlatReturn>());
+            case fnk_binary_expr:  return f(ast.template table<FlatBinaryExpr>());
+            case fnk_call:         return f(ast.template table<FlatCall>());
+            case fnk_call_arg:     return f(ast.template table<FlatCallArg>());
+            case fnk_identifier:   return f(ast.template table<FlatIdentifier>());
+            case fnk_int_literal:  return f(ast.template table<FlatIntegerLiteral>());
+            case fnk_bool_literal: return f(ast.template table<FlatBooleanLiteral>());
+        }
+        throw std::invalid_argument("unknown node kind in flat AST");
+    }
+
+    /// Visitor returning the metadata of a table, regardless of its kind.
+    struct TableMetadata {
+
+        template<typename T>
+        TableMetadata operator()(const FlatTable<T>& table) const {
+            return TableMetadata {
+                &table.types, &table.ranges,
+                table.nodes.capacity() * sizeof(T) };
+        }
+
+        const std::vector<FlatTypeID>*  types;
+        const std::vector<SourceRange>* ranges;
+        std::size_t                     nodes_size;
+
+    };
+
+    /// Visitor releasing the unused capacity of a table.
+    struct ShrinkTable {
+
+        template<typename T>
+        void operator()(FlatTable<T>& table) const {
+            table.nodes.shrink_to_fit();
+            table.types.shrink_to_fit();
+            table.ranges.shrink_to_fit();
+        }
+
+    };
+
+    static const FlatNodeKind all_kinds[] = {
+        fnk_block, fnk_prop_decl, fnk_param_decl, fnk_fun_decl, fnk_assignment, fnk_if,
+        fnk_return, fnk_binary_expr, fnk_call, fnk_call_arg, fnk_identifier, fnk_int_literal,
+        fnk_bool_literal,
+    };
+
+    // -----------------------------------------------------------------------
+
+    FlatAST::FlatAST() {
+        this->types.push_back(nullptr);
+        this->type_ids[nullptr] = 0;
+    }
+
+    FlatList FlatAST::add_list(const std::vector<FlatNodeID>& children) {
+        FlatList ret = {
+            static_cast<std::uint32_t>(this->children.size()),
+            static_cast<std::uint32_t>(children.size()) };
+        this->children.insert(this->children.end(), children.begin(), children.end());
+        return ret;
+    }
+
+    TypePtr FlatAST::get_type(FlatNodeID id) const {
+        auto metadata = with_table(*this, id.kind(), TableMetadata());
+        return this->types[(*metadata.types)[id.index()]];
+    }
+
+    const SourceRange& FlatAST::get_range(FlatNodeID id) const {
+        auto metadata = with_table(*this, id.kind(), TableMetadata());
+        return (*metadata.ranges)[id.index()];
+    }
+
+    FlatTypeID FlatAST::get_type_id(TypePtr type) {
+        auto it = this->type_ids.find(type);
+        if (it != this->type_ids.end()) {
+            return it->second;
+        }
+
+        auto ret = static_cast<FlatTypeID>(this->types.size());
+        this->types.push_back(type);
+        this->type_ids[type] = ret;
+        return ret;
+    }
+
+    std::size_t FlatAST::size() const {
+        std::size_t ret = 0;
+        for (auto kind: all_kinds) {
+            ret += with_table(*this, kind, TableMetadata()).types->size();
+        }
+        return ret;
+    }
+
+    void FlatAST::shrink_to_fit() {
+        for (auto kind: all_kinds) {
+            with_table(*this, kind, ShrinkTable());
+        }
+        this->children.shrink_to_fit();
+        this->captures.shrink_to_fit();
+    }
+
+    std::size_t FlatAST::get_footprint() const {
+        std::size_t ret = 0;
+        for (auto kind: all_kinds) {
+            auto metadata = with_table(*this, kind, TableMetadata());
+            ret += metadata.nodes_size;
+            ret += metadata.types->capacity()  * sizeof(FlatTypeID);
+            ret += metadata.ranges->capacity() * sizeof(SourceRange);
+        }
+        ret += this->children.capacity() * sizeof(FlatNodeID);
+        ret += this->captures.capacity() * sizeof(FlatCapture);
+        ret += this->types.capacity()    * sizeof(TypePtr);
+        return ret;
+    }
+
+    // -----------------------------------------------------------------------
+
+    /// Visitor that appends the nodes of a pointer-based AST to a flat AST.
+    ///
+    /// Children are flattened before their parents, so that their
+    /// references are known when their parents are added.
+    struct ASTFlattener: public ASTNodeVisitor {
+
+        ASTFlattener(FlatAST& ast): ast(ast) {}
+
+        FlatNodeID flatten(ASTNode& node) {
+            node.accept(*this);
+            return this->last;
+        }
+
+        template<typename T>
+        FlatList flatten_list(const ASTVector<T>& nodes) {
+            std::vector<FlatNodeID> children;
+            children.reserve(nodes.size());
+            for (auto node: nodes) {
+                children.push_back(this->flatten(*node));
+            }
+            return this->ast.add_list(children);
+        }
+
+        template<typename T>
+        void add(ASTNode& node, const T& flat_node) {
+            this->last = this->ast.add(flat_node, node.md_type, node.md_range);
+        }
+
+        void visit(Block& node) {
+            FlatBlock flat_node;
+            flat_node.statements = this->flatten_list(node.statements);
+            this->add(node, flat_node);
+        }
+
+        void visit(PropertyDecl& node) {
+            FlatPropertyDecl flat_node;
+            flat_node.name       = node.name;
+            flat_node.mutability = node.mutability;
+            flat_node.is_initialized_before_capture = node.is_initialized_before_capture;
+            this->add(node, flat_node);
+            this->decls[&node] = this->last;
+        }
+
+        void visit(ParamDecl& node) {
+            FlatParamDecl flat_node;
+            flat_node.name       = node.name;
+            flat_node.mutability = node.mutability;
+            this->add(node, flat_node);
+            this->decls[&node] = this->last;
+        }
+
+        void visit(FunctionDecl& node) {
+            FlatFunctionDecl flat_node;
+            flat_node.name       = node.name;
+            flat_node.parameters   = this->flatten_list(node.parameters);
+            flat_node.is_reachable = node.is_reachable;
+            flat_node.is_liftable  = node.is_liftable;
+
+            // Unreachable functions are flattened without their body, which
+            // is never generated nor, if it was deferred, parsed.
+            if (node.is_reachable) {
+                flat_node.body = this->flatten(*node.get_body());
+            }
+            this->add(node, flat_node);
+            this->decls[&node] = this->last;
+
+            // Captured declarations have already been flattened, as they're
+            // declared either in an enclosing scope or by the function itself.
+            FlatList capture_list = {
+                static_cast<std::uint32_t>(this->ast.captures.size()),
+                static_cast<std::uint32_t>(node.capture_list.size()) };
+            for (auto& val: node.capture_list) {
+                auto it = this->decls.find(val.decl);
+                if (it == this->decls.end()) {
+                    throw std::invalid_argument("capture of an undeclared symbol");
+                }
+                FlatCapture capture = { it->second, val.is_noescape };
+                this->ast.captures.push_back(capture);
+            }
+            this->ast.table<FlatFunctionDecl>().nodes[this->last.index()].capture_list = capture_list;
+        }
+
+        void visit(Assignment& node) {
+            FlatAssignment flat_node;
+            flat_node.lvalue = this->flatten(*node.lvalue);
+            flat_node.op     = node.op;
+            flat_node.rvalue = this->flatten(*node.rvalue);
+            this->add(node, flat_node);
+        }
+
+        void visit(If& node) {
+            FlatIf flat_node;
+            flat_node.condition  = this->flatten(*node.condition);
+            flat_node.then_block = this->flatten(*node.then_block);
+            flat_node.else_block = this->flatten(*node.else_block);
+            this->add(node, flat_node);
+        }
+
+        void visit(Return& node) {
+            FlatReturn flat_node;
+            flat_node.value = this->flatten(*node.value);
+            this->add(node, flat_node);
+        }
+
+        void visit(BinaryExpr& node) {
+            FlatBinaryExpr flat_node;
+            flat_node.left  = this->flatten(*node.left);
+            flat_node.right = this->flatten(*node.right);
+            flat_node.op    = node.op;
+            this->add(node, flat_node);
+        }
+
+        void visit(Call& node) {
+            FlatCall flat_node;
+            flat_node.callee    = this->flatten(*node.callee);
+            flat_node.arguments = this->flatten_list(node.arguments);
+            this->add(node, flat_node);
+        }
+
+        void visit(CallArg& node) {
+            FlatCallArg flat_node;
+            flat_node.label = node.label;
+            flat_node.op    = node.op;
+            flat_node.value = this->flatten(*node.value);
+            this->add(node, flat_node);
+        }
+
+        void visit(Identifier& node) {
+            FlatIdentifier flat_node;
+            flat_node.name = node.name;
+            this->add(node, flat_node);
+        }
+
+        void visit(IntegerLiteral& node) {
+            FlatIntegerLiteral flat_node;
+            flat_node.value = node.value;
+            this->add(node, flat_node);
+        }
+
+        void visit(BooleanLiteral& node) {
+            FlatBooleanLiteral flat_node;
+            flat_node.value = node.value;
+            this->add(node, flat_node);
+        }
+
+        FlatAST&                              ast;
+        FlatNodeID                            last;
+        std::unordered_map<Decl*, FlatNodeID> decls;
+
+    };
+
+
+    FlatAST flatten_ast(Block& module) {
+        FlatAST      ret;
+        ASTFlattener flattener(ret);
+        ret.root = flattener.flatten(module);
+        ret.shrink_to_fit();
+        return ret;
+    }
+
+    // -----------------------------------------------------------------------
+
+    void FlatASTAdapter::accept(ASTNodeVisitor& visitor) {
+        this->materialize_of_kind<Block>(this->ast.root, this->context)->accept(visitor);
+    }
+
+    template<typename T>
+    ASTVector<T*> FlatASTAdapter::materialize_list(FlatList list, ASTContext& context) {
+        auto ret = context.list<T*>();
+        ret.reserve(list.size);
+        for (std::uint32_t i = 0; i < list.size; ++i) {
+            ret.push_back(this->materialize_of_kind<T>(
+                this->ast.children[list.begin + i], context));
+        }
+        return ret;
+    }
+
+    ASTNode* FlatASTAdapter::materialize(FlatNodeID id, ASTContext& context) {
+        auto it = this->decls.find(id.bits);
+        if (it != this->decls.end()) {
+            return it->second;
+        }
+
+        ASTNode* ret;
+        switch (id.kind()) {
+            case fnk_block: {
+                auto& node = this->ast.get<FlatBlock>(id);
+                ret = context.create<Block>(
+                    this->materialize_list<ASTNode>(node.statements, context));
+                break;
+            }
+
+            case fnk_prop_decl: {
+                auto& node = this->ast.get<FlatPropertyDecl>(id);
+                auto  decl = context.create<PropertyDecl>(node.name, node.mutability);
+                decl->is_initialized_before_capture = node.is_initialized_before_capture;
+                this->decls[id.bits] = decl;
+                ret = decl;
+                break;
+            }
+
+            case fnk_param_decl: {
+                auto& node = this->ast.get<FlatParamDecl>(id);
+                auto  decl = context.create<ParamDecl>(node.name, node.mutability);
+                this->decls[id.bits] = decl;
+                ret = decl;
+                break;
+            }
+
+            case fnk_fun_decl: {
+                auto& node = this->ast.get<FlatFunctionDecl>(id);
+                auto  decl = context.create<FunctionDecl>(
+                    node.name,
+                    this->materialize_list<ParamDecl>(node.parameters, context),
+                    nullptr);
+                this->decls[id.bits] = decl;
+
+                // The function is registered before its body and captures are
+                // materialized, so that references to itself resolve to it.
+                decl->is_reachable = node.is_reachable;
+                decl->is_liftable  = node.is_liftable;
+                if (!node.body.is_none()) {
+                    decl->body = this->materialize_of_kind<Block>(node.body, context);
+                }
+                for (std::uint32_t i = 0; i < node.capture_list.size; ++i) {
+                    auto& capture = this->ast.captures[node.capture_list.begin + i];
+                    decl->capture_list.push_back(CapturedValue(
+                        this->materialize_of_kind<Decl>(capture.decl, context),
+                        capture.is_noescape));
+                }
+                ret = decl;
+                break;
+            }
+
+            case fnk_assignment: {
+                auto& node = this->ast.get<FlatAssignment>(id);
+                auto  lvalue = this->materialize(node.lvalue, context);
+                auto  rvalue = this->materialize(node.rvalue, context);
+                ret = context.create<Assignment>(lvalue, node.op, rvalue);
+                break;
+            }
+
+            case fnk_if: {
+                auto& node = this->ast.get<FlatIf>(id);
+                auto  condition  = this->materialize(node.condition, context);
+                auto  then_block = this->materialize_of_kind<Block>(node.then_block, context);
+                auto  else_block = this->materialize_of_kind<Block>(node.else_block, context);
+                ret = context.create<If>(condition, then_block, else_block);
+                break;
+            }
+
+            case fnk_return: {
+                auto& node = this->ast.get<FlatReturn>(id);
+                ret = context.create<Return>(this->materialize(node.value, context));
+                break;
+            }
+
+            case fnk_binary_expr: {
+                auto& node = this->ast.get<FlatBinaryExpr>(id);
+                auto  left  = this->materialize(node.left, context);
+                auto  right = this->materialize(node.right, context);
+                ret = context.create<BinaryExpr>(left, right, node.op);
+                break;
+            }
+
+            case fnk_call: {
+                auto& node = this->ast.get<FlatCall>(id);
+                auto  callee = this->materialize(node.callee, context);
+                ret = context.create<Call>(
+                    callee, this->materialize_list<CallArg>(node.arguments, context));
+                break;
+            }
+
+            case fnk_call_arg: {
+                auto& node = this->ast.get<FlatCallArg>(id);
+                ret = context.create<CallArg>(
+                    node.label, node.op, this->materialize(node.value, context));
+                break;
+            }
+
+            case fnk_identifier:
+                ret = context.create<Identifier>(this->ast.get<FlatIdentifier>(id).name);
+                break;
+
+            case fnk_int_literal:
+                ret = context.create<IntegerLiteral>(this->ast.get<FlatIntegerLiteral>(id).value);
+                break;
+
+            case fnk_bool_literal:
+                ret = context.create<BooleanLiteral>(this->ast.get<FlatBooleanLiteral>(id).value);
+                break;
+
+            default:
+                throw std::invalid_argument("unknown node kind in flat AST");
+        }
+
+        ret->md_type  = this->ast.get_type(id);
+        ret->md_range = this->ast.get_range(id);
+        return ret;
+    }
+
+} // namespace tango
@@ -0,0 +1,323 @@
+//
+//  flatast.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hh"
+
+
+namespace tango {
+
+    /// Kinds of the nodes of a flat AST.
+    ///
+    /// A kind is also the index of the table storing the nodes of that kind
+    /// in a FlatAST.
+    enum FlatNodeKind: std::uint8_t {
+        fnk_block, fnk_prop_decl, fnk_param_decl, fnk_fun_decl, fnk_assignment, fnk_if,
+        fnk_return, fnk_binary_expr, fnk_call, fnk_call_arg, fnk_identifier, fnk_int_literal,
+        fnk_bool_literal,
+    };
+
+    /// Reference to a node of a flat AST.
+    ///
+    /// The kind of the node is stored in the 4 high bits, and its index in
+    /// the table of its kind in the 28 low bits.
+    struct FlatNodeID {
+
+        FlatNodeID(): bits(0xFFFFFFFF) {}
+        FlatNodeID(FlatNodeKind kind, std::uint32_t index):
+            bits((std::uint32_t(kind) << 28) | index) {}
+
+        FlatNodeKind  kind()  const { return static_cast<FlatNodeKind>(this->bits >> 28); }
+        std::uint32_t index() const { return this->bits & 0x0FFFFFFF; }
+
+        bool is_none() const { return this->bits == 0xFFFFFFFF; }
+
+        bool operator==(FlatNodeID other) const { return this->bits == other.bits; }
+        bool operator!=(FlatNodeID other) const { return this->bits != other.bits; }
+
+        std::uint32_t bits;
+
+    };
+
+    /// Index of a type in the type table of a flat AST. The type 0 denotes
+    /// the absence of type.
+    typedef std::uint32_t FlatTypeID;
+
+    /// Range of consecutive entries in one of the pools of a flat AST.
+    struct FlatList {
+        std::uint32_t begin;
+        std::uint32_t size;
+    };
+
+    /// A captured value of a function declaration.
+    struct FlatCapture {
+        FlatNodeID decl;
+        bool       is_noescape;
+    };
+
+    // -----------------------------------------------------------------------
+
+    // The following structures mirror the fields of their pointer-based
+    // counterparts, with children stored as node references and lists as
+    // ranges of the child pool of the AST.
+
+    struct FlatBlock {
+        static const FlatNodeKind kind = fnk_block;
+        FlatList statements;
+    };
+
+    struct FlatPropertyDecl {
+        static const FlatNodeKind kind = fnk_prop_decl;
+        Symbol               name;
+        IdentifierMutability mutability;
+        bool                 is_initialized_before_capture;
+    };
+
+    struct FlatParamDecl {
+        static const FlatNodeKind kind = fnk_param_decl;
+        Symbol               name;
+        IdentifierMutability mutability;
+    };
+
+    struct FlatFunctionDecl {
+        static const FlatNodeKind kind = fnk_fun_decl;
+        Symbol     name;
+        FlatList   parameters;
+        FlatNodeID body;
+        FlatList   capture_list;
+        bool       is_reachable;
+        bool       is_liftable;
+    };
+
+    struct FlatAssignment {
+        static const FlatNodeKind kind = fnk_assignment;
+        FlatNodeID         lvalue;
+        AssignmentOperator op;
+        FlatNodeID         rvalue;
+    };
+
+    struct FlatIf {
+        static const FlatNodeKind kind = fnk_if;
+        FlatNodeID condition;
+        FlatNodeID then_block;
+        FlatNodeID else_block;
+    };
+
+    struct FlatReturn {
+        static const FlatNodeKind kind = fnk_return;
+        FlatNodeID value;
+    };
+
+    struct FlatBinaryExpr {
+        static const FlatNodeKind kind = fnk_binary_expr;
+        FlatNodeID left;
+        FlatNodeID right;
+        Operator   op;
+    };
+
+    struct FlatCall {
+        static const FlatNodeKind kind = fnk_call;
+        FlatNodeID callee;
+        FlatList   arguments;
+    };
+
+    struct FlatCallArg {
+        static const FlatNodeKind kind = fnk_call_arg;
+        Symbol             label;
+        AssignmentOperator op;
+        FlatNodeID         value;
+    };
+
+    struct FlatIdentifier {
+        static const FlatNodeKind kind = fnk_identifier;
+        Symbol name;
+    };
+
+    struct FlatIntegerLiteral {
+        static const FlatNodeKind kind = fnk_int_literal;
+        int value;
+    };
+
+    struct FlatBooleanLiteral {
+        static const FlatNodeKind kind = fnk_bool_literal;
+        bool value;
+    };
+
+    // -----------------------------------------------------------------------
+
+    /// Table of the nodes of a given kind.
+    ///
+    /// Metadata are stored in arrays parallel to the nodes, so that
+    /// traversals that don't need them don't pull them in the cache.
+    template<typename T>
+    struct FlatTable {
+        std::vector<T>           nodes;
+        std::vector<FlatTypeID>  types;
+        std::vector<SourceRange> ranges;
+    };
+
+    /// Flat representation of the AST of a module.
+    ///
+    /// Nodes are stored by kind in contiguous tables, and refer to their
+    /// children with 32-bit node references rather than pointers. Lists of
+    /// children are ranges of a single pool, and types are referred to by
+    /// their index in the type table of the AST.
+    struct FlatAST {
+
+        FlatAST();
+        FlatAST(const FlatAST&) = delete;
+        FlatAST(FlatAST&&) = default;
+
+        FlatAST& operator=(FlatAST&&) = default;
+
+        /// Returns the table of the nodes of type T.
+        template<typename T>
+        FlatTable<T>& table() {
+            return std::get<T::kind>(this->tables);
+        }
+
+        template<typename T>
+        const FlatTable<T>& table() const {
+            return std::get<T::kind>(this->tables);
+        }
+
+        /// Returns the node referred to by the given reference, which must be
+        /// of type T.
+        template<typename T>
+        const T& get(FlatNodeID id) const {
+            if (id.kind() != T::kind) {
+                throw std::invalid_argument("unexpected node kind in flat AST");
+            }
+            return this->table<T>().nodes[id.index()];
+        }
+
+        /// Appends a node to the table of its kind.
+        template<typename T>
+        FlatNodeID add(const T& node, TypePtr type, const SourceRange& range) {
+            auto& table = this->table<T>();
+            FlatNodeID ret(T::kind, static_cast<std::uint32_t>(table.nodes.size()));
+            table.nodes.push_back(node);
+            table.types.push_back(this->get_type_id(type));
+            table.ranges.push_back(range);
+            return ret;
+        }
+
+        /// Appends a list of children to the child pool.
+        FlatList add_list(const std::vector<FlatNodeID>& children);
+
+        /// Returns the type of the given node, or nullptr if it's untyped.
+        TypePtr get_type(FlatNodeID id) const;
+
+        /// Returns the source range of the given node.
+        const SourceRange& get_range(FlatNodeID id) const;
+
+        /// Returns the identifier of the given type in the type table,
+        /// adding it if necessary.
+        FlatTypeID get_type_id(TypePtr type);
+
+        /// Releases the unused capacity of the tables and pools, once the
+        /// AST has been built.
+        void shrink_to_fit();
+
+        /// Returns the number of nodes in the AST.
+        std::size_t size() const;
+
+        /// Returns the number of bytes used by the nodes, pools and tables of
+        /// the AST.
+        std::size_t get_footprint() const;
+
+        std::tuple<
+            FlatTable<FlatBlock>,
+            FlatTable<FlatPropertyDecl>,
+            FlatTable<FlatParamDecl>,
+            FlatTable<FlatFunctionDecl>,
+            FlatTable<FlatAssignment>,
+            FlatTable<FlatIf>,
+            FlatTable<FlatReturn>,
+            FlatTable<FlatBinaryExpr>,
+            FlatTable<FlatCall>,
+            FlatTable<FlatCallArg>,
+            FlatTable<FlatIdentifier>,
+            FlatTable<FlatIntegerLiteral>,
+            FlatTable<FlatBooleanLiteral>> tables;
+
+        /// The pool of the lists of children.
+        std::vector<FlatNodeID> children;
+
+        /// The pool of the capture lists.
+        std::vector<FlatCapture> captures;
+
+        /// The type table. The type 0 denotes the absence of type.
+        std::vector<TypePtr> types;
+
+        /// The module's block.
+        FlatNodeID root;
+
+    private:
+
+        std::unordered_map<TypePtr, FlatTypeID> type_ids;
+
+    };
+
+    /// Builds the flat representation of a module's AST.
+    FlatAST flatten_ast(Block& module);
+
+    // -----------------------------------------------------------------------
+
+    /// Lets visitors of pointer-based ASTs, such as the IR generator,
+    /// consume a flat AST.
+    ///
+    /// The module is materialized in a context owned by the adapter, as
+    /// visitors may keep pointers to its declarations until they're done,
+    /// e.g. in the bindings of the IR generator. The adapter must thus
+    /// outlive the visitors it is accepted by.
+    struct FlatASTAdapter {
+
+        FlatASTAdapter(const FlatAST& ast): ast(ast) {}
+        FlatASTAdapter(const FlatASTAdapter&) = delete;
+
+        /// Materializes the module's block, and lets the visitor visit it.
+        void accept(ASTNodeVisitor& visitor);
+
+        /// Materializes the subtree rooted at the given node in a context.
+        ///
+        /// Declarations are materialized once, so that capture lists refer
+        /// to the same nodes as the declarations of the subtree.
+        ASTNode* materialize(FlatNodeID id, ASTContext& context);
+
+    private:
+
+        template<typename T>
+        T* materialize_of_kind(FlatNodeID id, ASTContext& context) {
+            auto ret = dynamic_cast<T*>(this->materialize(id, context));
+            if (ret == nullptr) {
+                throw std::invalid_argument("unexpected node kind in flat AST");
+            }
+            return ret;
+        }
+
+        template<typename T>
+        ASTVector<T*> materialize_list(FlatList list, ASTContext& context);
+
+        const FlatAST& ast;
+
+        /// The context of the materialized module.
+        ASTContext context;
+
+        /// The declarations materialized so far, by node reference.
+        std::unordered_map<std::uint32_t, Decl*> decls;
+
+    };
+
+} // namespace tango
@@ -20,10 +20,10 @@ namespace irgen {
 
         // Dereference var and/or val if they're references.
         if (node.lvalue->md_type->is_reference()) {
-            var_loc = gen.builder.CreateLoad(var_loc);
+            var_loc = create_load(gen.builder, var_loc);
         }
         if (node.rvalue->md_type->is_reference()) {
-            val = gen.builder.CreateLoad(val);
+            val = create_load(gen.builder, val);
         }
 
         // Create a store instruction.
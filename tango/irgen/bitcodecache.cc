@@ -0,0 +1,249 @@
+//
+//  bitcodecache.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "bitcodecache.hh"
+#include "tango/types.hh"
+
+
+namespace tango {
+namespace irgen {
+
+    /// Version of the layout of cache keys, to be bumped whenever the IR
+    /// generator changes the code it emits.
+    static const char* const cache_key_version = "tango-bitcode-9";
+
+    /// Visitor that feeds the contents of a function declaration to a hash.
+    ///
+    /// Symbols and types are hashed by their textual contents rather than
+    /// by their identity, which depends on the order in which they were
+    /// created, so that keys are stable across compilations.
+    struct FunctionHasher: public ASTNodeVisitor {
+
+        FunctionHasher(llvm::MD5& hash): hash(hash) {}
+
+        void add_u32(std::uint32_t value) {
+            std::uint8_t bytes[] = {
+                std::uint8_t(value), std::uint8_t(value >> 8),
+                std::uint8_t(value >> 16), std::uint8_t(value >> 24) };
+            this->hash.update(llvm::ArrayRef<std::uint8_t>(bytes));
+        }
+
+        void add_string(const std::string& value) {
+            this->add_u32(static_cast<std::uint32_t>(value.size()));
+            this->hash.update(value);
+        }
+
+        void add_type(TypePtr type) {
+            if (type == nullptr) {
+                this->add_string("");
+            } else if (auto ref_type = dynamic_cast<const RefType*>(type)) {
+                this->add_string("&");
+                this->add_type(ref_type->referred_type);
+            } else if (auto fun_type = dynamic_cast<const FunctionType*>(type)) {
+                this->add_string("->");
+                this->add_u32(static_cast<std::uint32_t>(fun_type->domain.size()));
+                for (std::size_t i = 0; i < fun_type->domain.size(); ++i) {
+                    this->add_string(fun_type->labels[i].str());
+                    this->add_type(fun_type->domain[i]);
+                }
+                this->add_type(fun_type->codomain);
+            } else if (auto nominal_type = dynamic_cast<const NominalType*>(type)) {
+                this->add_string(nominal_type->name);
+            } else {
+                throw std::invalid_argument("unexpected type");
+            }
+        }
+
+        /// Adds the kind and the type of a node.
+        void add_node(const char* kind, ASTNode& node) {
+            this->add_string(kind);
+            this->add_type(node.md_type);
+        }
+
+        void visit(Block& node) {
+            this->add_node("Block", node);
+            this->add_u32(static_cast<std::uint32_t>(node.statements.size()));
+            for (auto statement: node.statements) {
+                statement->accept(*this);
+            }
+        }
+
+        void visit(PropertyDecl& node) {
+            this->add_node("PropertyDecl", node);
+            this->add_string(node.name.str());
+            this->add_u32(node.mutability);
+            this->add_u32(node.is_initialized_before_capture);
+        }
+
+        void visit(ParamDecl& node) {
+            this->add_node("ParamDecl", node);
+            this->add_string(node.name.str());
+            this->add_u32(node.mutability);
+        }
+
+        void visit(FunctionDecl& node) {
+            this->add_node("FunctionDecl", node);
+            this->add_string(node.name.str());
+            this->add_u32(node.is_reachable);
+            this->add_u32(node.is_liftable);
+            this->add_u32(static_cast<std::uint32_t>(node.parameters.size()));
+            for (auto parameter: node.parameters) {
+                parameter->accept(*this);
+            }
+
+            this->add_u32(static_cast<std::uint32_t>(node.capture_list.size()));
+            for (auto& val: node.capture_list) {
+                this->add_string(val.decl->name.str());
+                this->add_type(val.decl->get_type());
+                this->add_u32(val.is_noescape);
+            }
+
+            // Unreachable nested functions aren't generated, so their body
+            // doesn't affect the code of the function.
+            if (node.is_reachable) {
+                node.get_body()->accept(*this);
+            }
+        }
+
+        void visit(Assignment& node) {
+            this->add_node("Assignment", node);
+            this->add_u32(node.op);
+            node.lvalue->accept(*this);
+            node.rvalue->accept(*this);
+        }
+
+        void visit(If& node) {
+            this->add_node("If", node);
+            node.condition->accept(*this);
+            node.then_block->accept(*this);
+            node.else_block->accept(*this);
+        }
+
+        void visit(Return& node) {
+            this->add_node("Return", node);
+            node.value->accept(*this);
+        }
+
+        void visit(BinaryExpr& node) {
+            this->add_node("BinaryExpr", node);
+            this->add_u32(node.op);
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(Call& node) {
+            this->add_node("Call", node);
+            node.callee->accept(*this);
+            this->add_u32(static_cast<std::uint32_t>(node.arguments.size()));
+            for (auto argument: node.arguments) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit(CallArg& node) {
+            this->add_node("CallArg", node);
+            this->add_string(node.label.str());
+            this->add_u32(node.op);
+            node.value->accept(*this);
+        }
+
+        void visit(Identifier& node) {
+            this->add_node("Identifier", node);
+            this->add_string(node.name.str());
+        }
+
+        void visit(IntegerLiteral& node) {
+            this->add_node("IntegerLiteral", node);
+            this->add_u32(static_cast<std::uint32_t>(node.value));
+        }
+
+        void visit(BooleanLiteral& node) {
+            this->add_node("BooleanLiteral", node);
+            this->add_u32(node.value);
+        }
+
+        llvm::MD5& hash;
+
+    };
+
+    // -----------------------------------------------------------------------
+
+    BitcodeCache::BitcodeCache(const std::string& directory, const std::string& configuration):
+        directory(directory),
+        configuration(configuration)
+    {
+        if (llvm::sys::fs::create_directories(directory)) {
+            throw std::runtime_error("cannot create " + directory);
+        }
+    }
+
+
+    std::string BitcodeCache::get_key(llvm::ArrayRef<FunctionDecl*> group) const {
+        llvm::MD5 hash;
+        FunctionHasher hasher(hash);
+
+        // Bitcode is only readable by the version of LLVM that wrote it.
+        hasher.add_string(cache_key_version);
+        hasher.add_string(LLVM_VERSION_STRING);
+        hasher.add_string(this->configuration);
+        hasher.add_u32(static_cast<std::uint32_t>(group.size()));
+        for (auto fun_decl: group) {
+            fun_decl->accept(hasher);
+        }
+
+        llvm::MD5::MD5Result result;
+        hash.final(result);
+        llvm::SmallString<32> key;
+        llvm::MD5::stringifyResult(result, key);
+        return key.str().str();
+    }
+
+
+    std::unique_ptr<llvm::MemoryBuffer> BitcodeCache::load(const std::string& key) const {
+        auto buffer = llvm::MemoryBuffer::getFile(this->directory + "/" + key + ".bc");
+        if (!buffer) {
+            return nullptr;
+        }
+        return std::move(*buffer);
+    }
+
+
+    void BitcodeCache::store(const std::string& key, llvm::StringRef bitcode) const {
+        int fd;
+        llvm::SmallString<128> tmp_path;
+        if (llvm::sys::fs::createUniqueFile(this->directory + "/%%%%%%%%.tmp", fd, tmp_path)) {
+            return;
+        }
+
+        {
+            llvm::raw_fd_ostream os(fd, true);
+            os << bitcode;
+            os.close();
+            if (os.has_error()) {
+                os.clear_error();
+                llvm::sys::fs::remove(tmp_path);
+                return;
+            }
+        }
+
+        if (llvm::sys::fs::rename(tmp_path, this->directory + "/" + key + ".bc")) {
+            llvm::sys::fs::remove(tmp_path);
+        }
+    }
+
+} // namespace irgen
+} // namespace tango
@@ -0,0 +1,68 @@
+//
+//  bitcodecache.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "tango/ast.hh"
+
+
+namespace llvm {
+
+    class MemoryBuffer;
+
+} // namespace llvm
+
+
+namespace tango {
+namespace irgen {
+
+    /// On-disk cache of the optimized bitcode of global functions.
+    ///
+    /// Global functions are stored by groups, each in a module of its own,
+    /// under a key computed from the contents of their declarations: their
+    /// names, parameters, bodies, capture lists and the types of all their
+    /// nodes. Source ranges aren't part of the key, so that moving a function
+    /// doesn't invalidate its entry. As the types of identifiers are part of
+    /// the key, a change in the signature of a callee invalidates the
+    /// entries of its callers.
+    struct BitcodeCache {
+
+        /// Creates a cache in the given directory, which is created if it
+        /// doesn't exist.
+        ///
+        /// The configuration string should describe the settings that affect
+        /// the generated code (e.g. the optimization pipeline), so that
+        /// entries generated with different settings are kept apart.
+        BitcodeCache(const std::string& directory, const std::string& configuration);
+
+        /// Returns the key of a group of global function declarations.
+        std::string get_key(llvm::ArrayRef<FunctionDecl*> group) const;
+
+        /// Returns the bitcode stored under the given key, or nullptr if
+        /// there isn't any.
+        std::unique_ptr<llvm::MemoryBuffer> load(const std::string& key) const;
+
+        /// Stores the bitcode of a module under the given key.
+        ///
+        /// Entries are written to a temporary file that is then renamed, so
+        /// that concurrent compilations never read partial entries. Failing
+        /// to write an entry isn't an error, as it'll just be regenerated.
+        void store(const std::string& key, llvm::StringRef bitcode) const;
+
+        const std::string directory;
+        const std::string configuration;
+
+    };
+
+} // namespace irgen
+} // namespace tango
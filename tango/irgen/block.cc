@@ -13,9 +13,13 @@ namespace tango {
 namespace irgen {
 
     void IRGenerator::visit(Block& node) {
+        // Declarations of a block shadow those of enclosing blocks, until
+        // the end of the block.
+        scopes.push_scope();
         for (auto statement: node.statements) {
             statement->accept(*this);
         }
+        scopes.pop_scope();
     }
 
 } // namespace irgen
@@ -20,15 +20,19 @@ namespace irgen {
         }
 
         // Get the callee object.
-        auto& callee_name = static_cast<Identifier*>(node.callee)->name;
+        auto callee_name = static_cast<Identifier*>(node.callee)->name;
 
         // TODO: Handle non-identifier callees.
 
-        // If the callee name isn't in the local symbol table, the referred
-        // function is global, and we can get it from the symbol table of the
-        // module.
-        if (locals.empty() or (locals.top().find(callee_name) == locals.top().end())) {
-            auto callee = module.getFunction(callee_name);
+        // If the callee isn't bound to a nested function, the referred
+        // function is global, and we can get it from the table of global
+        // functions.
+        auto binding = scopes.lookup(callee_name);
+        if ((binding == nullptr) or (binding->closure == nullptr)) {
+            auto callee = get_global_function(callee_name);
+            if (callee == nullptr) {
+                throw std::invalid_argument("call to undefined function");
+            }
 
             // Set the function's arguments.
             std::vector<llvm::Value*> args;
@@ -40,14 +44,35 @@ namespace irgen {
 
             // Create the function call.
             stack.push(builder.CreateCall(callee, args));
-        } else {
-            auto closure_info = closures[callee_name];
-            auto closure_loc  = get_symbol_location(callee_name);
-            auto zero         = get_gep_index(0);
+        } else if (binding->closure->env_type == nullptr) {
+            // Lifted functions are called directly, with their captures as
+            // first arguments.
+            auto lifted = binding->closure->function;
+            std::vector<llvm::Value*> args;
+            for (auto val: binding->closure->decl->capture_list) {
+                auto location = get_capture_location(*val.decl);
+                args.push_back(is_captured_by_value(*val.decl)
+                    ? create_load(builder, location, val.decl->name.str())
+                    : location);
+            }
+            for (auto arg: node.arguments) {
+                arg->value->accept(*this);
+                args.push_back(stack.top());
+                stack.pop();
+            }
 
-            // Dereference the function pointer.
-            auto raw_ptr = builder.CreateLoad(builder.CreateGEP(closure_loc, {zero, zero}));
-            auto callee  = builder.CreateBitCast(raw_ptr, closure_info.fun_ptr_type);
+            // Create the function call.
+            stack.push(builder.CreateCall(lifted, args));
+        } else {
+            // Closures are never reassigned, so they're called directly,
+            // which lets LLVM inline them. Within the body of a closure, its
+            // own name is located by a pointer to its closure, rather than by
+            // the closure itself.
+            auto callee      = binding->closure->function;
+            auto closure_loc = binding->location;
+            if (closure_loc->getType()->getPointerElementType() != tango_types.closure_t) {
+                closure_loc = create_load(builder, closure_loc, callee_name.str());
+            }
 
             // Set the function's arguments.
             std::vector<llvm::Value*> args;
@@ -61,8 +86,6 @@ namespace irgen {
             // Create the function call.
             stack.push(builder.CreateCall(callee, args));
         }
-
-        // TODO: Handle escaping closures.
     }
     
 } // namespace irgen
@@ -0,0 +1,222 @@
+//
+//  codegen.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "bitcodecache.hh"
+#include "codegen.hh"
+#include "irgen.hh"
+#include "tango/allocstats.hh"
+#include "tango/timereport.hh"
+#include "tango/trace.hh"
+
+
+namespace tango {
+namespace irgen {
+
+    /// Generates and optimizes a unit in a context of its own, for the same
+    /// target as the given module, and returns its bitcode.
+    static std::unique_ptr<llvm::MemoryBuffer> generate_unit(
+        llvm::ArrayRef<FunctionDecl*>         unit,
+        const IRGenerator::ExternalDeclTable& global_decls,
+        const llvm::Module&                   main_module,
+        const OptimizeFunction&               optimize,
+        TimeReport*                           time_report)
+    {
+        TANGO_TRACE_SCOPE(trace_scope, "generate unit");
+        TANGO_TRACE_DETAIL(trace_scope, unit.front()->name.str());
+        llvm::LLVMContext context;
+        llvm::Module      module(unit.front()->name.str(), context);
+        module.setDataLayout(main_module.getDataLayoutStr());
+        module.setTargetTriple(main_module.getTargetTriple());
+        {
+            TimeReport::PhaseScope scope(time_report, "irgen");
+            llvm::IRBuilder<> builder(context);
+            IRGenerator ir_generator(module, builder);
+            ir_generator.external_decls = &global_decls;
+            ir_generator.time_report    = time_report;
+            for (auto fun_decl: unit) {
+                fun_decl->accept(ir_generator);
+            }
+        }
+        optimize(module);
+
+        TimeReport::PhaseScope     scope(time_report, "bitcode");
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::raw_svector_ostream  os(bitcode);
+        llvm::WriteBitcodeToFile(module, os);
+        return llvm::MemoryBuffer::getMemBufferCopy(
+            llvm::StringRef(bitcode.data(), bitcode.size()), module.getModuleIdentifier());
+    }
+
+
+    SplitModuleStatistics generate_split_module(
+        Block&                    module_decl,
+        llvm::Module&             module,
+        const SplitModuleOptions& options,
+        const OptimizeFunction&   optimize)
+    {
+        auto& context = module.getContext();
+
+        // Global symbols are visible from all units, which refer to those of
+        // other units by name, and are resolved when linking.
+        IRGenerator::ExternalDeclTable global_decls;
+        std::vector<FunctionDecl*>     fun_decls;
+        for (auto statement: module_decl.statements) {
+            if (auto decl = dynamic_cast<Decl*>(statement)) {
+                global_decls[decl->name] = decl;
+            }
+            auto fun_decl = dynamic_cast<FunctionDecl*>(statement);
+            if ((fun_decl != nullptr) and fun_decl->is_reachable) {
+                fun_decls.push_back(fun_decl);
+            }
+        }
+
+        auto unit_size  = std::max<std::size_t>(options.unit_size, 1);
+        auto unit_count = (fun_decls.size() + unit_size - 1) / unit_size;
+        auto get_unit   = [&](std::size_t unit) {
+            auto begin = unit * unit_size;
+            return llvm::ArrayRef<FunctionDecl*>(
+                fun_decls.data() + begin, std::min(unit_size, fun_decls.size() - begin));
+        };
+
+        std::vector<std::unique_ptr<llvm::MemoryBuffer>> bitcodes(unit_count);
+        std::vector<std::string>                         keys(unit_count);
+        std::vector<char>                                is_cached(unit_count, false);
+        std::vector<std::exception_ptr>                  errors(
+            std::min<std::size_t>(std::max(options.thread_count, 1u), unit_count));
+        std::atomic<std::size_t>                         next_unit(0);
+
+        auto work = [&](std::size_t worker) {
+            try {
+                MemoryCategoryScope memory_scope(mc_llvm);
+                std::size_t         unit;
+                while ((unit = next_unit.fetch_add(1)) < unit_count) {
+                    if (options.cache != nullptr) {
+                        TimeReport::PhaseScope scope(options.time_report, "cache");
+                        TANGO_TRACE_SCOPE(trace_scope, "cache load");
+                        keys[unit]     = options.cache->get_key(get_unit(unit));
+                        bitcodes[unit] = options.cache->load(keys[unit]);
+                        if (bitcodes[unit]) {
+                            is_cached[unit] = true;
+                            continue;
+                        }
+                    }
+
+                    bitcodes[unit] = generate_unit(
+                        get_unit(unit), global_decls, module, optimize, options.time_report);
+                    if (options.cache != nullptr) {
+                        TimeReport::PhaseScope scope(options.time_report, "cache");
+                        TANGO_TRACE_SCOPE(trace_scope, "cache store");
+                        options.cache->store(keys[unit], bitcodes[unit]->getBuffer());
+                    }
+                }
+            } catch (...) {
+                errors[worker] = std::current_exception();
+            }
+        };
+
+        // Generate the top-level statements in the main function, while the
+        // workers generate the units.
+        std::vector<std::thread> threads;
+        if (errors.size() > 1) {
+            for (std::size_t i = 0; i < errors.size(); ++i) {
+                threads.push_back(std::thread([&work, i] {
+                    set_thread_memory_category(mc_llvm);
+                    work(i);
+                }));
+            }
+        }
+
+        std::exception_ptr main_error;
+        try {
+            {
+                TimeReport::PhaseScope scope(options.time_report, "irgen");
+                TANGO_TRACE_SCOPE(trace_scope, "irgen top-level statements");
+                llvm::IRBuilder<> builder(context);
+                IRGenerator ir_generator(module, builder);
+                ir_generator.external_decls = &global_decls;
+                ir_generator.time_report    = options.time_report;
+                ir_generator.add_main_function();
+                for (auto statement: module_decl.statements) {
+                    if (dynamic_cast<FunctionDecl*>(statement) == nullptr) {
+                        statement->accept(ir_generator);
+                    }
+                }
+                ir_generator.finish_main_function();
+            }
+            optimize(module);
+        } catch (...) {
+            main_error = std::current_exception();
+        }
+
+        if (errors.size() == 1) {
+            work(0);
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        if (main_error) {
+            std::rethrow_exception(main_error);
+        }
+        for (auto& error: errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // Link the units in order. Cached entries that can't be read are
+        // generated again.
+        TimeReport::PhaseScope scope(options.time_report, "link");
+        TANGO_TRACE_SCOPE(trace_scope, "link units");
+        llvm::Linker linker(module);
+        for (std::size_t unit = 0; unit < unit_count; ++unit) {
+            auto unit_module = llvm::parseBitcodeFile(bitcodes[unit]->getMemBufferRef(), context);
+            if (!unit_module and is_cached[unit]) {
+                llvm::consumeError(unit_module.takeError());
+                is_cached[unit] = false;
+                bitcodes[unit] = generate_unit(
+                    get_unit(unit), global_decls, module, optimize, options.time_report);
+                options.cache->store(keys[unit], bitcodes[unit]->getBuffer());
+                unit_module = llvm::parseBitcodeFile(bitcodes[unit]->getMemBufferRef(), context);
+            }
+            if (!unit_module) {
+                llvm::consumeError(unit_module.takeError());
+                throw std::runtime_error("cannot read the bitcode of a unit");
+            }
+
+            if (linker.linkInModule(std::move(*unit_module))) {
+                throw std::runtime_error("cannot link unit " + get_unit(unit).front()->name.str());
+            }
+            bitcodes[unit].reset();
+        }
+
+        SplitModuleStatistics stats = {
+            unit_count,
+            static_cast<std::size_t>(std::count(is_cached.begin(), is_cached.end(), true)) };
+        return stats;
+    }
+
+} // namespace irgen
+} // namespace tango
@@ -0,0 +1,87 @@
+//
+//  codegen.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "tango/ast.hh"
+
+
+namespace llvm {
+
+    class Module;
+
+} // namespace llvm
+
+
+namespace tango {
+
+    struct TimeReport;
+
+namespace irgen {
+
+    struct BitcodeCache;
+
+    /// Function that optimizes a module.
+    ///
+    /// It may be called from several threads at once, on modules of
+    /// different LLVM contexts.
+    typedef std::function<void(llvm::Module&)> OptimizeFunction;
+
+    /// Options of the generation of a module split in units.
+    struct SplitModuleOptions {
+
+        SplitModuleOptions():
+            thread_count(1), unit_size(64), cache(nullptr), time_report(nullptr) {}
+
+        /// The number of threads on which units are generated.
+        unsigned thread_count;
+
+        /// The number of global functions of each unit.
+        std::size_t unit_size;
+
+        /// The cache in which the bitcode of units is looked up and stored,
+        /// or nullptr to always generate them.
+        const BitcodeCache* cache;
+
+        /// The report to which the costs of the generation are added, or
+        /// nullptr if they aren't measured.
+        TimeReport* time_report;
+
+    };
+
+    /// Counts of the units of a module, and of those found in the cache.
+    struct SplitModuleStatistics {
+        std::size_t unit_count;
+        std::size_t cache_hits;
+    };
+
+    /// Generates the IR code of a module, splitting its global functions in
+    /// units that are generated and optimized separately.
+    ///
+    /// Each unit is a run of consecutive reachable global functions, which is
+    /// generated in a module and LLVM context of its own, so that units can
+    /// be generated on several threads. Global symbols of other units are
+    /// declared as they're used. The bitcode of each unit is then linked
+    /// into the given module, where the top-level statements are generated,
+    /// in the order of the declarations. Units are generated for the data
+    /// layout and target triple of the given module.
+    ///
+    /// Units only depend on the unit size, and fresh contexts are used for
+    /// each of them, so the resulting module is the same whatever the number
+    /// of threads. It is however different from the module that a single
+    /// IR generator would produce, as functions are optimized separately.
+    SplitModuleStatistics generate_split_module(
+        Block&                    module_decl,
+        llvm::Module&             module,
+        const SplitModuleOptions& options,
+        const OptimizeFunction&   optimize);
+
+} // namespace irgen
+} // namespace tango
@@ -6,21 +6,59 @@
 //  Copyright © 2017 University of Geneva. All rights reserved.
 //
 
+#include <chrono>
+#include <unordered_set>
+
 #include <llvm/IR/Verifier.h>
 
 #include "irgen.hh"
 #include "tango/captureinfo.hh"
+#include "tango/timereport.hh"
+#include "tango/trace.hh"
 
 
 namespace tango {
 namespace irgen {
 
+    void emit_capture_locations(
+        FunctionDecl&      node,
+        const ClosureInfo& info,
+        llvm::Value*       closure,
+        IRGenerator&       gen)
+    {
+        if (node.capture_list.empty()) {
+            return;
+        }
+
+        auto zero    = gen.get_gep_index(0);
+        auto raw_ptr = create_load(gen.builder, gen.builder.CreateGEP(
+            gen.tango_types.closure_t, closure, {zero, gen.get_gep_index(1)}));
+        auto env     = gen.builder.CreateBitCast(
+            raw_ptr, llvm::PointerType::getUnqual(info.env_type), node.name.str() + "env");
+
+        std::size_t idx = 0;
+        for (auto val: node.capture_list) {
+            auto slot = gen.builder.CreateGEP(info.env_type, env, {zero, gen.get_gep_index(idx)});
+            auto location = is_captured_by_value(*val.decl)
+                ? slot
+                : create_load(gen.builder, slot, val.decl->name.str() + "ptr");
+            gen.scopes.bind(val.decl->name, Binding(location, val.decl, nullptr, idx++));
+        }
+    }
+
+
     void emit_function_body(
         FunctionDecl&       node,
         llvm::Function*     fun,
         llvm::FunctionType* fun_type,
         IRGenerator&        gen)
     {
+        // Measure the time spent generating the function, without its nested
+        // functions, which are accounted separately.
+        auto start_time           = std::chrono::steady_clock::now();
+        auto outer_nested_seconds = gen.nested_irgen_seconds;
+        gen.nested_irgen_seconds  = 0;
+
         // Create a new basic block to start insertion into.
         auto bb = llvm::BasicBlock::Create(gen.module.getContext(), "entry", fun);
         auto ib = gen.builder.GetInsertBlock();
@@ -28,26 +66,69 @@ namespace irgen {
 
         // Store the alloca and (Tango) return type of the return value.
         gen.return_alloca.push(create_alloca(fun, fun_type->getReturnType(), "rv"));
-        gen.return_type.push(std::static_pointer_cast<FunctionType>(node.get_type())->codomain);
-
-        // Store the function parameters in its local symbol table.
-        IRGenerator::LocalSymbolTable fun_locals;
+        gen.return_type.push(static_cast<const FunctionType*>(node.get_type())->codomain);
+
+        // Bind the function parameters in the scope of its body. Nested
+        // functions take additional first arguments: closures take their
+        // closure, which is named after the function itself, and lifted
+        // functions take their captures. Mutable captures are passed by
+        // reference, so they're located by their argument.
+        //
+        // The captures of closures are located once, in the entry block, by
+        // their slot in the environment if they're captured by value, or by
+        // the pointer it holds otherwise.
+        gen.scopes.push_function_scope();
+        std::size_t lifted_count = fun->arg_size() - node.parameters.size();
+        std::size_t idx          = 0;
         for (auto& arg: fun->args()) {
+            Symbol  name;
+            Binding binding;
+            if (idx >= lifted_count) {
+                auto param = node.parameters[idx - lifted_count];
+                name         = param->name;
+                binding.decl = param;
+
+                // Parameters captured by escaping closures are boxed.
+                if (gen.boxed_decls.count(param) > 0) {
+                    binding.location = gen.create_heap_alloc(arg.getType(), arg.getName().str());
+                    gen.builder.CreateStore(&arg, binding.location);
+                    gen.scopes.bind(name, binding);
+                    idx++;
+                    continue;
+                }
+            } else if (node.is_liftable) {
+                auto decl = node.capture_list[idx].decl;
+                name                  = decl->name;
+                binding.decl          = decl;
+                binding.capture_index = idx;
+                if (!is_captured_by_value(*decl)) {
+                    binding.location = &arg;
+                    gen.scopes.bind(name, binding);
+                    idx++;
+                    continue;
+                }
+            } else {
+                auto& info = gen.closures[&node];
+                name            = node.name;
+                binding.decl    = &node;
+                binding.closure = &info;
+                emit_capture_locations(node, info, &arg, gen);
+            }
+
             // Create an alloca for the argument, and store its value.
-            auto alloca = create_alloca(fun, arg.getType(), arg.getName());
-            gen.builder.CreateStore(&arg, alloca);
-            fun_locals[arg.getName()] = alloca;
+            binding.location = create_alloca(fun, arg.getType(), arg.getName().str());
+            gen.builder.CreateStore(&arg, binding.location);
+            gen.scopes.bind(name, binding);
+            idx++;
         }
 
-        gen.locals.push(std::move(fun_locals));
-
         // Generate the body of the function.
-        node.body->accept(gen);
-        gen.builder.CreateRet(gen.builder.CreateLoad(gen.return_alloca.top()));
+        node.get_body()->accept(gen);
+        gen.builder.CreateRet(create_load(gen.builder, gen.return_alloca.top()));
 
         gen.return_alloca.pop();
         gen.return_type.pop();
-        gen.locals.pop();
+        gen.scopes.pop_function_scope();
 
         if (ib == nullptr) {
             gen.builder.ClearInsertionPoint();
@@ -56,31 +137,86 @@ namespace irgen {
         }
 
         // Validate the generated code, checking for consistency.
-        llvm::verifyFunction(*fun);
+        {
+            TimeReport::PhaseScope scope(gen.time_report, "verify");
+            TANGO_TRACE_SCOPE(trace_scope, "verify");
+            TANGO_TRACE_DETAIL(trace_scope, fun->getName().str());
+            llvm::verifyFunction(*fun);
+        }
+
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_time).count();
+        if (gen.time_report != nullptr) {
+            FunctionCost cost;
+            cost.irgen_seconds = seconds - gen.nested_irgen_seconds;
+            gen.time_report->add_function_cost(fun->getName().str(), cost);
+        }
+        gen.nested_irgen_seconds = outer_nested_seconds + seconds;
     }
 
 
+    /// Collects the mutable values that escaping closures capture, within a
+    /// function and its nested functions.
+    struct BoxedDeclCollector: public ASTNodeVisitor {
+
+        BoxedDeclCollector(std::unordered_set<const Decl*>& decls): decls(decls) {}
+
+        void visit(Block& node) {
+            for (auto statement: node.statements) {
+                statement->accept(*this);
+            }
+        }
+
+        void visit(FunctionDecl& node) {
+            if (!node.is_reachable) {
+                return;
+            }
+            if (is_escaping(node)) {
+                for (auto val: node.capture_list) {
+                    if (!is_captured_by_value(*val.decl)) {
+                        this->decls.insert(val.decl);
+                    }
+                }
+            }
+            node.get_body()->accept(*this);
+        }
+
+        void visit(If& node) {
+            node.then_block->accept(*this);
+            node.else_block->accept(*this);
+        }
+
+        void visit(PropertyDecl&)   {}
+        void visit(ParamDecl&)      {}
+        void visit(Assignment&)     {}
+        void visit(Return&)         {}
+        void visit(BinaryExpr&)     {}
+        void visit(Call&)           {}
+        void visit(CallArg&)        {}
+        void visit(Identifier&)     {}
+        void visit(IntegerLiteral&) {}
+        void visit(BooleanLiteral&) {}
+
+        std::unordered_set<const Decl*>& decls;
+
+    };
+
+
     void emit_global_function(FunctionDecl& node, IRGenerator& gen) {
         // Global function don't need to be lifted, as they can only
         // capture other global symbols.
-        llvm::FunctionType* fun_type = static_cast<llvm::FunctionType*>(
-            node.get_type()->get_llvm_type(gen.module.getContext()));
+        auto fun      = gen.declare_global_function(node);
+        auto fun_type = fun->getFunctionType();
 
-        // Create the LLVM function prototype.
-        auto fun = llvm::Function::Create(
-            fun_type, llvm::Function::ExternalLinkage, node.name, &gen.module);
-        fun->addFnAttr(llvm::Attribute::NoUnwind);
-
-        // Set the name of the function arguments.
-        std::size_t idx = 0;
-        for (auto& arg: fun->args()) {
-            arg.setName(node.parameters[idx++]->name);
-        }
+        // Find the values to box before generating any of them. Values are
+        // only captured by the functions nested in the one declaring them.
+        gen.boxed_decls.clear();
+        gen.closures.clear();
+        BoxedDeclCollector collector(gen.boxed_decls);
+        node.get_body()->accept(collector);
 
         // Generate the function body.
-        gen.local_captures.push(IRGenerator::LocalCaptures());
         emit_function_body(node, fun, fun_type, gen);
-        gen.local_captures.pop();
     }
 
 
@@ -89,59 +225,56 @@ namespace irgen {
 
         // NOTE: We lift a nested function by adding a closure instance to its
         // parameter, which contain a pointer to the (global) function,
-        // as well as references to the captured values of its free variables.
-        // We use references to captured values rather than the a copies (even
-        // for primitive types) to handle mutable captures.
-        // There are two opportunities of optimization here:
-        // * Non-mutable captures could be passed by values, so as to avoid
-        //   unecessary load statements.
-        // * Non-recursive and non-escaping functions may be lifted by simply
-        //   adding their free variables to their parameter, so as to avoid
-        //   the allocation of a function environment.
+        // as well as its captured values. Constants are copied in the
+        // environment, so that reading them only takes a load from it, while
+        // mutable captures are stored as references to the variables, so
+        // that assignments are shared with the enclosing function. Constants
+        // that may be initialized after the closure is created are captured
+        // by reference as well.
+        // Functions that are only called directly by the function declaring
+        // them are lifted by emit_lifted_function instead.
 
         // Create the type of the function.
-        llvm::FunctionType* fun_type = std::static_pointer_cast<FunctionType>(node.get_type())
-            ->get_llvm_lifted_type(ctx, gen.tango_types.closure_t);
-
-        // We need to keep track of which local symbols correspond to captured
-        // values, so we can dereference them from the environment during the
-        // IR generation of the function's body.
-        IRGenerator::LocalCaptures fun_local_captures;
+        auto current_fun = gen.builder.GetInsertBlock()->getParent();
+        llvm::FunctionType* fun_type = gen.tango_types.get_llvm_lifted_type(node.get_type());
 
         // Create the type of the function's enivornment.
         std::vector<llvm::Type*> env_members;
         for (auto val: node.capture_list) {
-            auto free_type = val.decl->get_type()->get_llvm_type(ctx);
-            env_members.push_back(llvm::PointerType::getUnqual(free_type));
-            fun_local_captures.push_back(val.decl->name);
+            auto free_type = gen.tango_types.get_llvm_type(val.decl->get_type());
+            env_members.push_back(is_captured_by_value(*val.decl)
+                ? free_type
+                : llvm::PointerType::getUnqual(free_type));
         }
-        fun_local_captures.push_back(node.name);
         llvm::StructType* env_type = llvm::StructType::create(
-            ctx, env_members, node.name + "env_t");
+            ctx, env_members, node.name.str() + "env_t");
 
-        // Create the LLVM function prototype.
+        // Create the LLVM function prototype. Nested functions are named
+        // after the functions that declare them, so that their names are
+        // unique across modules.
         auto fun = llvm::Function::Create(
-            fun_type, llvm::Function::PrivateLinkage, node.name, &gen.module);
+            fun_type, llvm::Function::PrivateLinkage,
+            current_fun->getName() + "." + node.name.str(), &gen.module);
         fun->addFnAttr(llvm::Attribute::NoUnwind);
 
         // Set the name of the function arguments.
         auto arg_it = fun->arg_begin();
-        arg_it->setName(node.name);
+        arg_it->setName(node.name.str());
         arg_it++;
         std::size_t idx = 0;
         while (arg_it != fun->arg_end()) {
-            arg_it->setName(node.parameters[idx++]->name);
+            arg_it->setName(node.parameters[idx++]->name.str());
             arg_it++;
         }
 
         // Create a local symbol representing the first-class function object
-        auto current_fun    = gen.builder.GetInsertBlock()->getParent();
-        auto closure_alloca = create_alloca(current_fun, gen.tango_types.closure_t, node.name);
+        auto closure_alloca = create_alloca(
+            current_fun, gen.tango_types.closure_t, node.name.str());
 
         // Store the closure info.
-        gen.closures[node.name] = ClosureInfo(
-            &node, llvm::PointerType::getUnqual(fun_type), env_type);
-        gen.locals.top()[node.name] = closure_alloca;
+        auto& info = gen.closures[&node];
+        info = ClosureInfo(&node, fun, fun_type, env_type);
+        gen.scopes.bind(node.name, Binding(closure_alloca, &node, &info));
 
         // Store the function pointer.
         // %0 = getelementptr %closure_t, %closure_t* %<fun_name>, i32 0, i32 0
@@ -149,39 +282,97 @@ namespace irgen {
         auto zero = gen.get_gep_index(0);
         gen.builder.CreateStore(
             gen.builder.CreateBitCast(fun, gen.tango_types.voidp_t),
-            gen.builder.CreateGEP(closure_alloca, {zero, zero}));
+            gen.builder.CreateGEP(gen.tango_types.closure_t, closure_alloca, {zero, zero}));
 
         // If the function isn't escaping, we can allocate its environment on
-        // the stack.
-        idx             = 0;
-        auto env_alloca = create_alloca(current_fun, env_type, node.name + "env");
+        // the stack. Otherwise, it's allocated on the heap, so that it
+        // outlives the frame of the function creating the closure.
+        idx = 0;
+        llvm::Value* env    = is_escaping(node)
+            ? gen.create_heap_alloc(env_type, node.name.str() + "env")
+            : create_alloca(current_fun, env_type, node.name.str() + "env");
         for (auto val: node.capture_list) {
+            auto location = gen.get_capture_location(*val.decl);
             gen.builder.CreateStore(
-                gen.get_symbol_location(val.decl->name),
-                gen.builder.CreateGEP(env_alloca, {zero, gen.get_gep_index(idx)}));
+                is_captured_by_value(*val.decl)
+                    ? create_load(gen.builder, location, val.decl->name.str())
+                    : location,
+                gen.builder.CreateGEP(env_type, env, {zero, gen.get_gep_index(idx++)}));
         }
 
         // %1 = getelementptr %closure_t, %closure_t* %<fun_name>, i32 0, i32 1
         // store i8* null, i8** %1
         gen.builder.CreateStore(
-            gen.builder.CreateBitCast(env_alloca, gen.tango_types.voidp_t),
-            gen.builder.CreateGEP(closure_alloca, {zero, gen.get_gep_index(1)}));
-
-        // TODO: Handle escaping closures.
+            gen.builder.CreateBitCast(env, gen.tango_types.voidp_t),
+            gen.builder.CreateGEP(
+                gen.tango_types.closure_t, closure_alloca, {zero, gen.get_gep_index(1)}));
 
         // Generate the function body.
-        gen.local_captures.push(std::move(fun_local_captures));
         emit_function_body(node, fun, fun_type, gen);
-        gen.local_captures.pop();
+    }
+
+
+    void emit_lifted_function(FunctionDecl& node, IRGenerator& gen) {
+        // NOTE: Functions that are neither recursive nor escaping are lambda
+        // lifted, i.e. their captures are added to their parameters, so that
+        // they are called directly, without a closure nor an environment.
+        // Constants are passed by value, and mutable captures by reference.
+        auto current_fun = gen.builder.GetInsertBlock()->getParent();
+        auto tango_type  = static_cast<const FunctionType*>(node.get_type());
+        auto base_type   = static_cast<llvm::FunctionType*>(gen.tango_types.get_llvm_type(tango_type));
+
+        std::vector<llvm::Type*> param_types;
+        for (auto val: node.capture_list) {
+            auto free_type = gen.tango_types.get_llvm_type(val.decl->get_type());
+            param_types.push_back(is_captured_by_value(*val.decl)
+                ? free_type
+                : llvm::PointerType::getUnqual(free_type));
+        }
+        param_types.insert(param_types.end(), base_type->param_begin(), base_type->param_end());
+        auto fun_type = llvm::FunctionType::get(base_type->getReturnType(), param_types, false);
+
+        // Create the LLVM function prototype, named like closures.
+        auto fun = llvm::Function::Create(
+            fun_type, llvm::Function::PrivateLinkage,
+            current_fun->getName() + "." + node.name.str(), &gen.module);
+        fun->addFnAttr(llvm::Attribute::NoUnwind);
+
+        // Set the name of the function arguments.
+        std::size_t idx = 0;
+        for (auto& arg: fun->args()) {
+            arg.setName((idx < node.capture_list.size())
+                ? node.capture_list[idx].decl->name.str()
+                : node.parameters[idx - node.capture_list.size()]->name.str());
+            idx++;
+        }
+
+        // Calls locate the function by its symbol, and get its captures from
+        // its closure info.
+        auto& info = gen.closures[&node];
+        info = ClosureInfo(&node, fun, fun_type, nullptr);
+        gen.scopes.bind(node.name, Binding(fun, &node, &info));
+
+        // Generate the function body. Captures are regular locals.
+        emit_function_body(node, fun, fun_type, gen);
     }
 
 
     void IRGenerator::visit(FunctionDecl& node) {
+        // Functions that can't be called aren't generated at all.
+        if (!node.is_reachable) {
+            return;
+        }
+
+        TANGO_TRACE_SCOPE(trace_scope, "irgen FunctionDecl");
+        TANGO_TRACE_DETAIL(trace_scope, node.name.str());
+
         // If we're not generating the body of a function, we're looking at a
         // global function.
         auto insert_block = builder.GetInsertBlock();
         if (insert_block == nullptr) {
             emit_global_function(node, *this);
+        } else if (node.is_liftable) {
+            emit_lifted_function(node, *this);
         } else {
             emit_nested_function(node, *this);
         }
@@ -15,7 +15,7 @@ namespace irgen {
     void IRGenerator::visit(Identifier& node) {
         // Look for the identifier in the local/global symbol tables.
         auto loc = get_symbol_location(node.name);
-        this->stack.push(builder.CreateLoad(loc, node.name.c_str()));
+        this->stack.push(create_load(builder, loc, node.name.str()));
     }
     
 } // namespace irgen
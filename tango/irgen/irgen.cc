@@ -18,7 +18,12 @@ namespace irgen {
     IRGenerator::IRGenerator(
         llvm::Module& mod,
         llvm::IRBuilder<>& irb):
-        module(mod), builder(llvm::IRBuilder<>(mod.getContext())), tango_types(mod.getContext()) {}
+        module(mod),
+        builder(mod.getContext()),
+        external_decls(nullptr),
+        time_report(nullptr),
+        nested_irgen_seconds(0),
+        tango_types(mod.getContext()) {}
 
 
     void IRGenerator::add_main_function() {
@@ -27,7 +32,8 @@ namespace irgen {
         auto i8pp = llvm::PointerType::getUnqual(llvm::PointerType::getUnqual(i8));
 
         // define i32 @main(i32, i8**)
-        auto fn = static_cast<llvm::Function*>(module.getOrInsertFunction("main", i32, i32, i8pp));
+        auto fn = llvm::cast<llvm::Function>(
+            module.getOrInsertFunction("main", i32, i32, i8pp).getCallee());
         llvm::BasicBlock::Create(module.getContext(), "entry", fn);
     }
 
@@ -60,43 +66,120 @@ namespace irgen {
     }
 
 
-    llvm::Value* IRGenerator::get_symbol_location(const std::string& name) {
-        if (!locals.empty()) {
-            auto it = locals.top().find(name);
-            if (it != locals.top().end()) {
-                return it->second;
-            }
+    void IRGenerator::visit(BinaryExpr&) {
+        // Binary expressions aren't lowered yet. Skipping them would leave
+        // no value on the stack for the node that uses theirs.
+        throw std::invalid_argument("unsupported expression");
+    }
+
+
+    llvm::Value* IRGenerator::get_symbol_location(Symbol name) {
+        auto binding = scopes.lookup(name);
+        if (binding != nullptr) {
+            return binding->location;
         }
 
-        if (!local_captures.empty()) {
-            auto fun_name = builder.GetInsertBlock()->getParent()->getName();
-            auto it       = locals.top().find(fun_name);
-            if (it != locals.top().end()) {
-                auto closure = builder.CreateLoad(it->second);
-                if (name == fun_name) {
-                    return it->second;
+        auto global_var = get_global_variable(name);
+        if (global_var != nullptr) {
+            return global_var;
+        }
+
+        throw std::invalid_argument("undefined symbol");
+    }
+
+
+    llvm::Value* IRGenerator::get_capture_location(const Decl& decl) {
+        auto binding = scopes.lookup(decl.name, &decl);
+        if (binding == nullptr) {
+            throw std::invalid_argument("undefined captured symbol");
+        }
+        return binding->location;
+    }
+
+
+    llvm::Function* IRGenerator::declare_global_function(FunctionDecl& node) {
+        auto fun_type = static_cast<llvm::FunctionType*>(
+            tango_types.get_llvm_type(node.get_type()));
+
+        // Create the LLVM function prototype.
+        auto fun = llvm::Function::Create(
+            fun_type, llvm::Function::ExternalLinkage, node.name.str(), &module);
+        fun->addFnAttr(llvm::Attribute::NoUnwind);
+        functions[node.name] = fun;
+
+        // Set the name of the function arguments.
+        std::size_t idx = 0;
+        for (auto& arg: fun->args()) {
+            arg.setName(node.parameters[idx++]->name.str());
+        }
+
+        return fun;
+    }
+
+
+    llvm::Function* IRGenerator::get_global_function(Symbol name) {
+        auto it = functions.find(name);
+        if (it != functions.end()) {
+            return it->second;
+        }
+
+        if (external_decls != nullptr) {
+            auto decl_it = external_decls->find(name);
+            if (decl_it != external_decls->end()) {
+                auto fun_decl = dynamic_cast<FunctionDecl*>(decl_it->second);
+                if (fun_decl != nullptr) {
+                    return declare_global_function(*fun_decl);
                 }
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    llvm::GlobalVariable* IRGenerator::get_global_variable(Symbol name) {
+        auto binding = scopes.lookup_global(name);
+        if (binding != nullptr) {
+            return llvm::dyn_cast<llvm::GlobalVariable>(binding->location);
+        }
 
-                auto captures   = local_captures.top();
-                auto capture_it = std::find(captures.begin(), captures.end(), name);
-                if (capture_it != captures.end()) {
-                    auto zero    = get_gep_index(0);
-                    auto raw_ptr = builder.CreateLoad(
-                        builder.CreateGEP(closure, {zero, get_gep_index(1)}));
-                    auto env_ptr = builder.CreateBitCast(
-                        raw_ptr, llvm::PointerType::getUnqual(closures[fun_name].env_type));
-                    auto idx     = get_gep_index(std::distance(captures.begin(), capture_it));
-                    return builder.CreateLoad(builder.CreateGEP(env_ptr, {zero, idx}));
+        if (external_decls != nullptr) {
+            auto decl_it = external_decls->find(name);
+            if (decl_it != external_decls->end()) {
+                auto prop_decl = dynamic_cast<PropertyDecl*>(decl_it->second);
+                if (prop_decl != nullptr) {
+                    // The variable is defined (with common linkage) by the
+                    // module that holds the top-level statements.
+                    auto global_var = new llvm::GlobalVariable(
+                        module, tango_types.get_llvm_type(prop_decl->get_type()), false,
+                        llvm::GlobalValue::ExternalLinkage, nullptr, name.str());
+                    scopes.bind_global(name, Binding(global_var, prop_decl));
+                    return global_var;
                 }
             }
         }
 
-        auto it = globals.find(name);
-        if (it != globals.end()) {
-            return it->second;
+        return nullptr;
+    }
+
+
+    llvm::Value* IRGenerator::create_heap_alloc(llvm::Type* type, const std::string& name) {
+        auto& ctx = module.getContext();
+        auto  i64 = llvm::Type::getInt64Ty(ctx);
+
+        // declare noalias i8* @tango_alloc(i64) nounwind
+        auto alloc_fun = module.getFunction("tango_alloc");
+        if (alloc_fun == nullptr) {
+            alloc_fun = llvm::Function::Create(
+                llvm::FunctionType::get(tango_types.voidp_t, { i64 }, false),
+                llvm::Function::ExternalLinkage, "tango_alloc", &module);
+            alloc_fun->addFnAttr(llvm::Attribute::NoUnwind);
+            alloc_fun->addRetAttr(llvm::Attribute::NoAlias);
         }
 
-        throw std::invalid_argument("undefined symbol");
+        auto size = module.getDataLayout().getTypeAllocSize(type);
+        auto ptr  = builder.CreateCall(alloc_fun, { llvm::ConstantInt::get(i64, size) });
+        return builder.CreateBitCast(ptr, llvm::PointerType::getUnqual(type), name);
     }
 
 
@@ -105,6 +188,23 @@ namespace irgen {
     }
 
 
+    bool is_captured_by_value(const Decl& decl) {
+        if (auto prop_decl = dynamic_cast<const PropertyDecl*>(&decl)) {
+            return (prop_decl->mutability == im_cst) and prop_decl->is_initialized_before_capture;
+        }
+        if (auto param_decl = dynamic_cast<const ParamDecl*>(&decl)) {
+            return param_decl->mutability == im_cst;
+        }
+        return false;
+    }
+
+
+    bool is_escaping(const FunctionDecl& decl) {
+        return std::any_of(decl.capture_list.begin(), decl.capture_list.end(),
+            [](const CapturedValue& val) { return !val.is_noescape; });
+    }
+
+
     llvm::AllocaInst* create_alloca(
         llvm::Function*    fun,
         llvm::Type*        type,
@@ -114,5 +214,17 @@ namespace irgen {
         return tmp_builder.CreateAlloca(type, 0, name);
     }
 
+
+    llvm::LoadInst* create_load(
+        llvm::IRBuilder<>& builder,
+        llvm::Value*       ptr,
+        const llvm::Twine& name)
+    {
+        // The IR generator only deals with typed pointers, so the type of
+        // the loaded value is the element type of the pointer.
+        auto type = ptr->getType()->getPointerElementType();
+        return builder.CreateLoad(type, ptr, name);
+    }
+
 } // namespace irgen
 } // namespace tango
@@ -12,16 +12,20 @@
 #include <stack>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <llvm/IR/IRBuilder.h>
 
+#include "scopetable.hh"
 #include "tango/ast.hh"
+#include "tango/symbol.hh"
 
 
 namespace llvm {
 
     class AllocaInst;
     class Function;
+    class FunctionType;
     class GlobalVariable;
     class Module;
     class Type;
@@ -32,30 +36,37 @@ namespace llvm {
 
 namespace tango {
 
+    struct TimeReport;
     struct TypeBase;
-    typedef std::shared_ptr<TypeBase> TypePtr;
+    typedef const TypeBase* TypePtr;
 
 namespace irgen {
 
     /// Struct that stores a function object and its capture list.
+    ///
+    /// Lifted functions have no environment, hence a null env_type. The
+    /// LLVM function a closure refers to is known statically, as closures
+    /// of nested functions are never reassigned, so calls to it are direct.
     struct ClosureInfo {
-        ClosureInfo(FunctionDecl* decl, llvm::Type* fun_ptr_type, llvm::StructType* env_type)
-            : decl(decl), fun_ptr_type(fun_ptr_type), env_type(env_type) {}
-        ClosureInfo(const ClosureInfo& other)
-            : decl(other.decl), fun_ptr_type(other.fun_ptr_type), env_type(other.env_type) {};
+        ClosureInfo(
+            FunctionDecl*       decl,
+            llvm::Function*     function,
+            llvm::FunctionType* fun_type,
+            llvm::StructType*   env_type)
+            : decl(decl), function(function), fun_type(fun_type), env_type(env_type) {}
         ClosureInfo()
-            : decl(nullptr), fun_ptr_type(nullptr), env_type(nullptr) {}
+            : decl(nullptr), function(nullptr), fun_type(nullptr), env_type(nullptr) {}
 
-        FunctionDecl*     decl;
-        llvm::Type*       fun_ptr_type;
-        llvm::StructType* env_type;
+        FunctionDecl*       decl;
+        llvm::Function*     function;
+        llvm::FunctionType* fun_type;
+        llvm::StructType*   env_type;
     };
 
     struct IRGenerator: public ASTNodeVisitor {
-        typedef std::vector<std::string>                               LocalCaptures;
-        typedef std::unordered_map<std::string, llvm::AllocaInst*>     LocalSymbolTable;
-        typedef std::unordered_map<std::string, llvm::GlobalVariable*> GlobalSymbolTable;
-        typedef std::unordered_map<std::string, ClosureInfo>           ClosureInfoTable;
+        typedef std::unordered_map<Symbol, llvm::Function*>           GlobalFunctionTable;
+        typedef std::unordered_map<const FunctionDecl*, ClosureInfo> ClosureInfoTable;
+        typedef std::unordered_map<Symbol, Decl*>                     ExternalDeclTable;
 
         IRGenerator(llvm::Module& mod, llvm::IRBuilder<>& irb);
         // IRGenerator(const IRGenerator&) = delete;
@@ -70,10 +81,10 @@ namespace irgen {
         void visit(Identifier&);
         void visit(IntegerLiteral&);
         void visit(BooleanLiteral&);
+        void visit(BinaryExpr&);
 
-        void visit(ParamDecl&)  {}
-        void visit(BinaryExpr&) {}
-        void visit(CallArg&)    {}
+        void visit(ParamDecl&) {}
+        void visit(CallArg&)   {}
 
         /// Adds a main function to the module under generation.
         void add_main_function();
@@ -85,7 +96,27 @@ namespace irgen {
         void move_to_main_function();
 
         /// Returns the location of a symbol from the local or global table.
-        llvm::Value* get_symbol_location(const std::string& name);
+        llvm::Value* get_symbol_location(Symbol name);
+
+        /// Returns the location of a local declaration that a nested
+        /// function captures, which may be shadowed where the function is
+        /// created or called.
+        llvm::Value* get_capture_location(const Decl& decl);
+
+        /// Creates the prototype of a global function, without its body.
+        llvm::Function* declare_global_function(FunctionDecl& node);
+
+        /// Returns the LLVM function of a global function, declaring it if
+        /// it's defined in another module, or nullptr if it's undefined.
+        llvm::Function* get_global_function(Symbol name);
+
+        /// Returns the LLVM variable of a global property, declaring it if
+        /// it's defined in another module, or nullptr if it's undefined.
+        llvm::GlobalVariable* get_global_variable(Symbol name);
+
+        /// Allocates a value of the given type with the allocator of the
+        /// runtime, and returns a pointer to it. The value is never freed.
+        llvm::Value* create_heap_alloc(llvm::Type* type, const std::string& name);
 
         // Returns an LLVM value suitable for GEP indices.
         llvm::Value* get_gep_index(std::size_t idx);
@@ -103,23 +134,43 @@ namespace irgen {
         /// particular statement has been generated.
         std::stack<llvm::Value*> stack;
 
-        /// A stack of maps of local symbols.
+        /// The scopes of local and global symbols, with their locations.
         ///
-        /// It's a stack so that we can handle nested function definitions.
-        std::stack<LocalSymbolTable> locals;
+        /// Locations are usually allocas, but captures of closures are
+        /// located by their slot in the environment or the pointer it holds,
+        /// mutable captures of lifted functions by their parameters, and
+        /// lifted functions themselves by their LLVM function.
+        ScopeTable scopes;
+
+        /// A map of the LLVM functions of global function declarations.
+        GlobalFunctionTable functions;
 
-        /// A stack of sets of captured symbols, that are used to determine if
-        /// a local symbol corresponds to a pointer to a captured value.
+        /// A map of the global declarations defined in other modules, if the
+        /// module under generation is meant to be linked with them.
         ///
-        /// It's a stack so that we can handle nested function definitions.
-        std::stack<LocalCaptures> local_captures;
+        /// Those symbols are declared in the module upon their first use.
+        const ExternalDeclTable* external_decls;
+
+        /// The report to which the costs of the IR generation are added, or
+        /// nullptr if they aren't measured.
+        TimeReport* time_report;
 
-        /// A map of global symbols.
-        GlobalSymbolTable globals;
+        /// The time spent generating the nested functions of the function
+        /// being generated, which isn't accounted to the function itself.
+        double nested_irgen_seconds;
 
-        /// A map of the ClosureInfo objects.
+        /// The ClosureInfo objects of the nested functions of the global
+        /// function being generated, by declaration. Bindings of nested
+        /// functions refer to them.
         ClosureInfoTable closures;
 
+        /// The mutable values that escaping closures capture, within the
+        /// global function being generated.
+        ///
+        /// They're boxed on the heap rather than allocated on the stack, so
+        /// that they outlive the frame that declares them.
+        std::unordered_set<const Decl*> boxed_decls;
+
         /// A stack of pointers to the alloca that represent the return space
         /// of the function declaration being visited.
         ///
@@ -136,11 +187,29 @@ namespace irgen {
         TangoLLVMTypes tango_types;
     };
 
+    /// Returns whether a captured declaration is stored by value in the
+    /// environment of the closures that capture it.
+    ///
+    /// Constants can't change once they're initialized, so closures copy
+    /// them rather than keeping a pointer to their location, unless they
+    /// may be captured before their initialization.
+    bool is_captured_by_value(const Decl& decl);
+
+    /// Returns whether a closure may outlive the frame that creates it, i.e.
+    /// whether any of its captures is flagged as escaping.
+    bool is_escaping(const FunctionDecl& decl);
+
     /// Create an alloca instruction in the enty block of the function.
     llvm::AllocaInst* create_alloca(
         llvm::Function*    function,
         llvm::Type*        type,
         const std::string& name);
 
+    /// Create a load instruction of the value a pointer points to.
+    llvm::LoadInst* create_load(
+        llvm::IRBuilder<>&  builder,
+        llvm::Value*        ptr,
+        const llvm::Twine&  name = "");
+
 } // namespace irgen
 } // namespace tango
@@ -14,7 +14,7 @@ namespace irgen {
 
     void IRGenerator::visit(PropertyDecl& node) {
         // Get the LLVM type of the property.
-        auto prop_type = node.get_type()->get_llvm_type(module.getContext());
+        auto prop_type = tango_types.get_llvm_type(node.get_type());
 
         // Check whether the variable is a reference, in which case we create
         // a pointer type to the variable's referred type.
@@ -27,20 +27,26 @@ namespace irgen {
         // global variable.
         auto insert_block = builder.GetInsertBlock();
         if (insert_block == nullptr) {
-            // Create a global variable.
-            module.getOrInsertGlobal(node.name, prop_type);
-            auto global_var = module.getNamedGlobal(node.name);
+            // Create a global variable. Common symbols must be initialized
+            // with zero, without which the variable would only be declared.
+            module.getOrInsertGlobal(node.name.str(), prop_type);
+            auto global_var = module.getNamedGlobal(node.name.str());
             global_var->setLinkage(llvm::GlobalVariable::CommonLinkage);
+            global_var->setInitializer(llvm::Constant::getNullValue(prop_type));
 
             // Store the variable in the global symbol table.
-            globals[node.name] = global_var;
+            scopes.bind_global(node.name, Binding(global_var, &node));
         } else {
             // Get the LLVM function under declaration.
             auto fun = insert_block->getParent();
 
             // Create an alloca for the variable, and store it as a local
-            // symbol table.
-            locals.top()[node.name] = create_alloca(fun, prop_type, node.name);
+            // symbol table. Variables captured by escaping closures are
+            // boxed on the heap instead.
+            auto location = (boxed_decls.count(&node) > 0)
+                ? create_heap_alloc(prop_type, node.name.str())
+                : create_alloca(fun, prop_type, node.name.str());
+            scopes.bind(node.name, Binding(location, &node));
         }
 
         // TODO: Handle garbage collected variables.
@@ -25,7 +25,7 @@ namespace irgen {
 
         // Dereference rv if it's a reference.
         if (node.value->get_type()->is_reference()) {
-            rv = builder.CreateLoad(rv);
+            rv = create_load(builder, rv);
         }
 
         // Store it on the return alloca.
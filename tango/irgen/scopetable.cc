@@ -0,0 +1,119 @@
+//
+//  scopetable.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <stdexcept>
+
+#include "scopetable.hh"
+
+
+namespace tango {
+namespace irgen {
+
+    const std::size_t Binding::no_capture;
+
+
+    void ScopeTable::push_scope() {
+        this->scope_starts.push_back(this->entries.size());
+        this->function_scopes.push_back(false);
+    }
+
+
+    void ScopeTable::pop_scope() {
+        if (this->scope_starts.empty()) {
+            throw std::invalid_argument("no scope to pop");
+        }
+
+        // Restore the bindings shadowed by those of the scope.
+        auto start = this->scope_starts.back();
+        while (this->entries.size() > start) {
+            auto& entry = this->entries.back();
+            this->heads[entry.name.id] = entry.shadowed;
+            this->entries.pop_back();
+        }
+
+        if (this->function_scopes.back()) {
+            this->function_depth -= 1;
+        }
+        this->scope_starts.pop_back();
+        this->function_scopes.pop_back();
+    }
+
+
+    void ScopeTable::push_function_scope() {
+        this->push_scope();
+        this->function_scopes.back() = true;
+        this->function_depth += 1;
+    }
+
+
+    void ScopeTable::pop_function_scope() {
+        if (this->function_scopes.empty() or !this->function_scopes.back()) {
+            throw std::invalid_argument("innermost scope isn't that of a function");
+        }
+        this->pop_scope();
+    }
+
+
+    void ScopeTable::bind(Symbol name, const Binding& binding) {
+        if (this->scope_starts.empty()) {
+            throw std::invalid_argument("local binding outside of any scope");
+        }
+        if (name.id >= this->heads.size()) {
+            this->heads.resize(name.id + 1, 0);
+        }
+
+        Entry entry = { name, binding, this->function_depth, this->heads[name.id] };
+        this->entries.push_back(entry);
+        this->heads[name.id] = static_cast<std::uint32_t>(this->entries.size());
+    }
+
+
+    void ScopeTable::bind_global(Symbol name, const Binding& binding) {
+        if (name.id >= this->globals.size()) {
+            this->globals.resize(name.id + 1);
+        }
+        this->globals[name.id] = binding;
+    }
+
+
+    const Binding* ScopeTable::lookup(Symbol name) const {
+        // Skip the locals of enclosing functions, which are only visible
+        // through captures.
+        if (name.id < this->heads.size()) {
+            for (auto i = this->heads[name.id]; i != 0; i = this->entries[i - 1].shadowed) {
+                auto& entry = this->entries[i - 1];
+                if (entry.function_depth == this->function_depth) {
+                    return &entry.binding;
+                }
+            }
+        }
+        return this->lookup_global(name);
+    }
+
+
+    const Binding* ScopeTable::lookup(Symbol name, const Decl* decl) const {
+        if (name.id < this->heads.size()) {
+            for (auto i = this->heads[name.id]; i != 0; i = this->entries[i - 1].shadowed) {
+                auto& entry = this->entries[i - 1];
+                if ((entry.function_depth == this->function_depth) and (entry.binding.decl == decl)) {
+                    return &entry.binding;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+
+    const Binding* ScopeTable::lookup_global(Symbol name) const {
+        if ((name.id < this->globals.size()) and (this->globals[name.id].location != nullptr)) {
+            return &this->globals[name.id];
+        }
+        return nullptr;
+    }
+
+} // namespace irgen
+} // namespace tango
@@ -0,0 +1,141 @@
+//
+//  scopetable.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tango/ast.hh"
+#include "tango/symbol.hh"
+
+
+namespace llvm {
+
+    class Value;
+
+} // namespace llvm
+
+
+namespace tango {
+namespace irgen {
+
+    struct ClosureInfo;
+
+    /// The location of a symbol, along with what the IR generator knows
+    /// about the declaration it's bound to.
+    struct Binding {
+
+        static const std::size_t no_capture = static_cast<std::size_t>(-1);
+
+        Binding(
+            llvm::Value*       location      = nullptr,
+            const Decl*        decl          = nullptr,
+            const ClosureInfo* closure       = nullptr,
+            std::size_t        capture_index = no_capture):
+            location(location), decl(decl), closure(closure), capture_index(capture_index) {}
+
+        /// The location of the symbol, usually an alloca or a global.
+        llvm::Value* location;
+
+        /// The declaration bound to the symbol, if any.
+        const Decl* decl;
+
+        /// The closure info of nested functions, which are located by their
+        /// closure or, for lifted functions, by their LLVM function. Within
+        /// the body of a closure, its own name is bound to a pointer to the
+        /// closure it receives.
+        const ClosureInfo* closure;
+
+        /// The index of captured values in the capture list of the function
+        /// being generated, or no_capture.
+        std::size_t capture_index;
+
+    };
+
+    /// Lexical scopes of the symbols of the module being generated.
+    ///
+    /// Symbols are interned, so each one indexes the latest of its local
+    /// bindings, which in turn refers to the one it shadows. Binding and
+    /// looking up a symbol are thus constant-time, as are pushing a scope and
+    /// popping each of its bindings.
+    ///
+    /// Locals are only visible within the function that binds them, so
+    /// nested functions reach the locals of the functions that enclose them
+    /// through their captures. Global bindings are never popped.
+    struct ScopeTable {
+
+        ScopeTable(): function_depth(0) {}
+
+        /// Pushes a scope for a block.
+        void push_scope();
+
+        /// Pops the innermost scope, with its bindings.
+        void pop_scope();
+
+        /// Pushes the outermost scope of a function body, in which the
+        /// locals of enclosing functions aren't visible anymore.
+        void push_function_scope();
+
+        /// Pops the outermost scope of a function body.
+        void pop_function_scope();
+
+        /// Binds a symbol in the innermost scope, shadowing the bindings of
+        /// enclosing scopes.
+        void bind(Symbol name, const Binding& binding);
+
+        /// Binds a symbol in the global scope.
+        void bind_global(Symbol name, const Binding& binding);
+
+        /// Returns the binding of a symbol that is visible from the function
+        /// being generated, looking up its locals first, or nullptr if it
+        /// isn't bound. Bindings are invalidated by subsequent calls to bind.
+        const Binding* lookup(Symbol name) const;
+
+        /// Returns the binding of a declaration that is visible from the
+        /// function being generated, even if its name is shadowed, or
+        /// nullptr if it isn't bound.
+        const Binding* lookup(Symbol name, const Decl* decl) const;
+
+        /// Returns the global binding of a symbol, or nullptr if it isn't
+        /// bound.
+        const Binding* lookup_global(Symbol name) const;
+
+    private:
+
+        struct Entry {
+            Symbol      name;
+            Binding     binding;
+            std::size_t function_depth;
+
+            /// One plus the index of the entry it shadows, or 0.
+            std::uint32_t shadowed;
+        };
+
+        /// The local bindings, from the outermost scope.
+        std::vector<Entry> entries;
+
+        /// One plus the index of the latest local binding of each symbol,
+        /// or 0, indexed by symbol id.
+        std::vector<std::uint32_t> heads;
+
+        /// The number of entries at the start of each scope, and whether
+        /// the scope is that of a function body.
+        std::vector<std::size_t> scope_starts;
+        std::vector<bool>        function_scopes;
+
+        /// The global bindings, indexed by symbol id.
+        std::vector<Binding> globals;
+
+        /// The number of function bodies being generated.
+        std::size_t function_depth;
+
+    };
+
+} // namespace irgen
+} // namespace tango
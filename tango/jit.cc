@@ -0,0 +1,95 @@
+//
+//  jit.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <stdexcept>
+
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/Mangling.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include "jit.hh"
+#include "runtime.hh"
+#include "target.hh"
+
+
+namespace tango {
+
+    /// Returns the value of an expected result, or throws its error.
+    template<typename T>
+    static T get_or_throw(llvm::Expected<T> value) {
+        if (!value) {
+            throw std::runtime_error(llvm::toString(value.takeError()));
+        }
+        return std::move(*value);
+    }
+
+
+    int run_module(
+        std::unique_ptr<llvm::Module>      module,
+        std::unique_ptr<llvm::LLVMContext> context,
+        const TargetDescription&           target,
+        const std::vector<std::string>&    arguments)
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        // The module has already been optimized, so the JIT uses the fast
+        // instruction selector and register allocator, which compile about
+        // ten times faster than the default ones.
+        llvm::orc::JITTargetMachineBuilder target_machine_builder((llvm::Triple(target.triple)));
+        target_machine_builder.setCPU(target.cpu);
+        target_machine_builder.getFeatures() = llvm::SubtargetFeatures(target.features);
+        target_machine_builder.setCodeGenOptLevel(llvm::CodeGenOpt::None);
+
+        auto jit = get_or_throw(llvm::orc::LLJITBuilder()
+            .setJITTargetMachineBuilder(std::move(target_machine_builder))
+            .create());
+
+        // Resolve the symbols the module doesn't define in the process. The
+        // functions of the runtime are defined explicitly, as the symbols of
+        // the compiler itself aren't necessarily exported.
+        auto& main_dylib = jit->getMainJITDylib();
+        main_dylib.addGenerator(get_or_throw(
+            llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                jit->getDataLayout().getGlobalPrefix())));
+
+        llvm::orc::MangleAndInterner mangle(jit->getExecutionSession(), jit->getDataLayout());
+        llvm::orc::SymbolMap         runtime_symbols;
+        runtime_symbols[mangle("tango_alloc")] = llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(&tango_alloc), llvm::JITSymbolFlags::Exported);
+        if (auto error = main_dylib.define(llvm::orc::absoluteSymbols(std::move(runtime_symbols)))) {
+            throw std::runtime_error(llvm::toString(std::move(error)));
+        }
+
+        auto error = jit->addIRModule(
+            llvm::orc::ThreadSafeModule(std::move(module), std::move(context)));
+        if (error) {
+            throw std::runtime_error(llvm::toString(std::move(error)));
+        }
+
+        auto main_symbol = get_or_throw(jit->lookup("main"));
+        auto main_fun    = reinterpret_cast<int (*)(int, char**)>(main_symbol.getAddress());
+
+        // Build a null-terminated argument vector, as main expects.
+        std::vector<std::string> argv_strings(arguments);
+        std::vector<char*>       argv;
+        for (auto& argument: argv_strings) {
+            argv.push_back(&argument[0]);
+        }
+        argv.push_back(nullptr);
+
+        return main_fun(static_cast<int>(arguments.size()), argv.data());
+    }
+
+} // namespace tango
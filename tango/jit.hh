@@ -0,0 +1,44 @@
+//
+//  jit.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace llvm {
+
+    class LLVMContext;
+    class Module;
+
+} // namespace llvm
+
+
+namespace tango {
+
+    struct TargetDescription;
+
+    /// Compiles a module in memory, and runs its `main` function in the
+    /// current process.
+    ///
+    /// The module is compiled for the given target, which should be the
+    /// host's, by an ORC JIT that takes the ownership of the module and of
+    /// its context. Symbols the module
+    /// doesn't define are looked up in the runtime, then in the current
+    /// process, so that Tango programs can call the C library.
+    ///
+    /// Returns the exit status of `main`, which is called with the given
+    /// arguments.
+    int run_module(
+        std::unique_ptr<llvm::Module>       module,
+        std::unique_ptr<llvm::LLVMContext>  context,
+        const TargetDescription&            target,
+        const std::vector<std::string>&     arguments);
+
+} // namespace tango
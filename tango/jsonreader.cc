@@ -0,0 +1,405 @@
+//
+//  jsonreader.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "jsonreader.hh"
+
+
+namespace tango {
+
+    JSONReader::JSONReader(std::istream& is, std::size_t offset):
+        buffer(is.rdbuf()), consumed(offset) {}
+
+
+    void JSONReader::begin_object() {
+        this->expect('{');
+        this->first.push_back(true);
+    }
+
+
+    bool JSONReader::next_key(std::string& key) {
+        if (this->peek() == '}') {
+            this->get();
+            this->first.pop_back();
+            return false;
+        }
+
+        if (!this->first.back()) {
+            this->expect(',');
+        }
+        this->first.back() = false;
+
+        this->read_string(key);
+        this->expect(':');
+        return true;
+    }
+
+
+    void JSONReader::begin_array() {
+        this->expect('[');
+        this->first.push_back(true);
+    }
+
+
+    bool JSONReader::next_element() {
+        if (this->peek() == ']') {
+            this->get();
+            this->first.pop_back();
+            return false;
+        }
+
+        if (!this->first.back()) {
+            this->expect(',');
+        }
+        this->first.back() = false;
+        return true;
+    }
+
+
+    std::string JSONReader::read_string() {
+        std::string ret;
+        this->read_string(ret);
+        return ret;
+    }
+
+
+    double JSONReader::read_number() {
+        this->skip_whitespace();
+
+        // Collect the characters that may appear in a JSON number, and let
+        // strtod validate them.
+        char        digits[64];
+        std::size_t len = 0;
+        int         c   = this->buffer->sgetc();
+        while ((c == '-') or (c == '+') or (c == '.') or (c == 'e') or (c == 'E') or
+               ((c >= '0') and (c <= '9')))
+        {
+            if (len == sizeof(digits) - 1) {
+                this->error("number literal is too long");
+            }
+            digits[len++] = static_cast<char>(this->get());
+            c = this->buffer->sgetc();
+        }
+        digits[len] = '\0';
+
+        char*  end;
+        double ret = std::strtod(digits, &end);
+        if ((len == 0) or (end != digits + len)) {
+            this->error("invalid number literal");
+        }
+        return ret;
+    }
+
+
+    bool JSONReader::read_bool() {
+        if (this->peek() == 't') {
+            this->read_literal("true");
+            return true;
+        }
+        this->read_literal("false");
+        return false;
+    }
+
+
+    void JSONReader::read_null() {
+        this->skip_whitespace();
+        this->read_literal("null");
+    }
+
+
+    void JSONReader::skip_value() {
+        // Strings are skipped without being decoded, so that skipping large
+        // subtrees doesn't allocate.
+        switch (this->peek()) {
+            case '{':
+                this->begin_object();
+                while (this->peek() != '}') {
+                    if (!this->first.back()) {
+                        this->expect(',');
+                    }
+                    this->first.back() = false;
+                    this->skip_string();
+                    this->expect(':');
+                    this->skip_value();
+                }
+                this->get();
+                this->first.pop_back();
+                break;
+            case '[':
+                this->begin_array();
+                while (this->next_element()) {
+                    this->skip_value();
+                }
+                break;
+            case '"':
+                this->skip_string();
+                break;
+            case 't':
+            case 'f':
+                this->read_bool();
+                break;
+            case 'n':
+                this->read_null();
+                break;
+            default:
+                this->read_number();
+        }
+    }
+
+
+    void JSONReader::seek(std::size_t offset) {
+        auto distance = static_cast<std::streamoff>(offset - this->consumed);
+        if (this->buffer->pubseekoff(distance, std::ios::cur, std::ios::in) == std::streampos(-1)) {
+            this->error("cannot seek in the input");
+        }
+        this->consumed = offset;
+    }
+
+
+    char JSONReader::peek() {
+        this->skip_whitespace();
+        int c = this->buffer->sgetc();
+        if (c == std::char_traits<char>::eof()) {
+            this->error("unexpected end of input");
+        }
+        return static_cast<char>(c);
+    }
+
+
+    void JSONReader::error(const std::string& message) const {
+        throw std::invalid_argument(
+            "malformed JSON at offset " + std::to_string(this->consumed) + ": " + message);
+    }
+
+
+    int JSONReader::get() {
+        int c = this->buffer->sbumpc();
+        if (c == std::char_traits<char>::eof()) {
+            this->error("unexpected end of input");
+        }
+        this->consumed += 1;
+        return c;
+    }
+
+
+    void JSONReader::expect(char c) {
+        if (this->peek() != c) {
+            this->error(std::string("expected '") + c + "'");
+        }
+        this->get();
+    }
+
+
+    void JSONReader::skip_whitespace() {
+        int c = this->buffer->sgetc();
+        while ((c == ' ') or (c == '\n') or (c == '\r') or (c == '\t')) {
+            this->buffer->sbumpc();
+            this->consumed += 1;
+            c = this->buffer->sgetc();
+        }
+    }
+
+
+    void JSONReader::read_string(std::string& out) {
+        this->expect('"');
+        out.clear();
+
+        while (true) {
+            int c = this->get();
+            if (c == '"') {
+                return;
+            }
+            if (c != '\\') {
+                out.push_back(static_cast<char>(c));
+                continue;
+            }
+
+            switch (this->get()) {
+                case '"':  out.push_back('"');  break;
+                case '\\': out.push_back('\\'); break;
+                case '/':  out.push_back('/');  break;
+                case 'b':  out.push_back('\b'); break;
+                case 'f':  out.push_back('\f'); break;
+                case 'n':  out.push_back('\n'); break;
+                case 'r':  out.push_back('\r'); break;
+                case 't':  out.push_back('\t'); break;
+                case 'u': {
+                    unsigned long code_point = this->read_hex4();
+
+                    // Combine UTF-16 surrogate pairs.
+                    if ((code_point >= 0xD800) and (code_point <= 0xDBFF)) {
+                        if ((this->get() != '\\') or (this->get() != 'u')) {
+                            this->error("unpaired UTF-16 surrogate");
+                        }
+                        unsigned long low = this->read_hex4();
+                        if ((low < 0xDC00) or (low > 0xDFFF)) {
+                            this->error("unpaired UTF-16 surrogate");
+                        }
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    this->append_utf8(out, code_point);
+                    break;
+                }
+                default:
+                    this->error("invalid escape sequence");
+            }
+        }
+    }
+
+
+    void JSONReader::skip_string() {
+        this->expect('"');
+        while (true) {
+            int c = this->get();
+            if (c == '"') {
+                return;
+            }
+            if ((c == '\\') and (this->get() == 'u')) {
+                this->read_hex4();
+            }
+        }
+    }
+
+
+    void JSONReader::read_literal(const char* literal) {
+        for (const char* it = literal; *it != '\0'; ++it) {
+            if (this->get() != *it) {
+                this->error(std::string("expected '") + literal + "'");
+            }
+        }
+    }
+
+
+    void JSONReader::append_utf8(std::string& out, unsigned long code_point) {
+        if (code_point < 0x80) {
+            out.push_back(static_cast<char>(code_point));
+        } else if (code_point < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else if (code_point < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+
+    unsigned long JSONReader::read_hex4() {
+        unsigned long ret = 0;
+        for (int i = 0; i < 4; ++i) {
+            int c = this->get();
+            ret <<= 4;
+            if ((c >= '0') and (c <= '9')) {
+                ret |= static_cast<unsigned long>(c - '0');
+            } else if ((c >= 'a') and (c <= 'f')) {
+                ret |= static_cast<unsigned long>(c - 'a' + 10);
+            } else if ((c >= 'A') and (c <= 'F')) {
+                ret |= static_cast<unsigned long>(c - 'A' + 10);
+            } else {
+                this->error("invalid unicode escape");
+            }
+        }
+        return ret;
+    }
+
+
+    /// Returns the offset just past the end of the string whose opening
+    /// quote is at the given offset.
+    static std::size_t skip_json_string(const char* data, std::size_t size, std::size_t offset) {
+        std::size_t i = offset + 1;
+        while (i < size) {
+            auto quote = static_cast<const char*>(std::memchr(data + i, '"', size - i));
+            if (quote == nullptr) {
+                return size;
+            }
+
+            // The quote is escaped if it's preceded by an odd number of
+            // backslashes.
+            std::size_t end        = quote - data;
+            std::size_t backslashes = 0;
+            while ((end - backslashes > offset + 1) and (data[end - backslashes - 1] == '\\')) {
+                backslashes += 1;
+            }
+            if (backslashes % 2 == 0) {
+                return end + 1;
+            }
+            i = end + 1;
+        }
+        return size;
+    }
+
+    std::size_t skip_json_value(const char* data, std::size_t size, std::size_t offset) {
+        if (offset >= size) {
+            return size;
+        }
+
+        // Skip scalars up to the first delimiter.
+        switch (data[offset]) {
+            case '"':
+                return skip_json_string(data, size, offset);
+            case '{':
+            case '[':
+                break;
+            default: {
+                std::size_t i = offset;
+                while ((i < size) and (std::strchr(",]} \n\r\t", data[i]) == nullptr)) {
+                    i += 1;
+                }
+                return i;
+            }
+        }
+
+        // Within containers, only brackets and quotes are of interest, so
+        // we look them up in a table to skip everything else quickly.
+        static const struct StructuralCharacters {
+            StructuralCharacters(): table() {
+                for (auto c: {'"', '{', '[', '}', ']'}) {
+                    this->table[static_cast<unsigned char>(c)] = true;
+                }
+            }
+            bool table[256];
+        } structural;
+
+        std::size_t depth = 0;
+        std::size_t i     = offset;
+        while (i < size) {
+            while ((i < size) and !structural.table[static_cast<unsigned char>(data[i])]) {
+                i += 1;
+            }
+            if (i == size) {
+                break;
+            }
+
+            switch (data[i]) {
+                case '"':
+                    i = skip_json_string(data, size, i);
+                    continue;
+                case '{':
+                case '[':
+                    depth += 1;
+                    break;
+                default:
+                    depth -= 1;
+                    if (depth == 0) {
+                        return i + 1;
+                    }
+            }
+            i += 1;
+        }
+        return size;
+    }
+
+} // namespace tango
@@ -0,0 +1,95 @@
+//
+//  jsonreader.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+namespace tango {
+
+    /// A pull parser that reads a JSON document token by token from a stream.
+    ///
+    /// Unlike nlohmann::json, the reader never materializes the document.
+    /// Consumers walk the document with begin_object/next_key and
+    /// begin_array/next_element, and either read or skip the values they
+    /// get to. Malformed documents are reported with std::invalid_argument.
+    struct JSONReader {
+
+        /// Creates a reader for the stream, whose current position is at the
+        /// given offset in the document (used to report errors).
+        JSONReader(std::istream& is, std::size_t offset = 0);
+        JSONReader(const JSONReader&) = delete;
+
+        /// Consumes the opening brace of an object.
+        void begin_object();
+
+        /// Reads the next key of the current object into `key`, or consumes
+        /// the closing brace of the object and returns false.
+        bool next_key(std::string& key);
+
+        /// Consumes the opening bracket of an array.
+        void begin_array();
+
+        /// Prepares the reader to parse the next element of the current
+        /// array, or consumes its closing bracket and returns false.
+        bool next_element();
+
+        std::string read_string();
+        double      read_number();
+        bool        read_bool();
+        void        read_null();
+
+        /// Skips the next value, whatever its kind.
+        void skip_value();
+
+        /// Moves the reader forward to the given offset in the document,
+        /// which must be within the current container, before the start of
+        /// one of its members/elements or its closing character.
+        void seek(std::size_t offset);
+
+        /// Returns the next non-whitespace character, without consuming it.
+        char peek();
+
+        /// Returns the offset of the reader in the document.
+        std::size_t offset() const { return this->consumed; }
+
+        /// Throws an error that points at the current offset.
+        [[noreturn]] void error(const std::string& message) const;
+
+    private:
+
+        int  get();
+        void expect(char c);
+        void skip_whitespace();
+        void read_string(std::string& out);
+        void skip_string();
+        void read_literal(const char* literal);
+        void append_utf8(std::string& out, unsigned long code_point);
+        unsigned long read_hex4();
+
+        std::streambuf* buffer;
+        std::size_t     consumed;
+
+        /// Whether the next member/element of each open container is its
+        /// first one, so we know when to expect a comma.
+        std::vector<bool> first;
+
+    };
+
+    /// Returns the offset just past the JSON value that starts at the given
+    /// offset of a buffer.
+    ///
+    /// Only strings and brackets are matched, so that large values can be
+    /// skipped much faster than with JSONReader::skip_value, but the value
+    /// isn't validated.
+    std::size_t skip_json_value(const char* data, std::size_t size, std::size_t offset);
+
+} // namespace tango
@@ -0,0 +1,31 @@
+//
+//  jsonwriter.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <cstdio>
+
+#include "jsonwriter.hh"
+
+
+namespace tango {
+
+    void write_json_string(std::ostream& os, const std::string& value) {
+        os << '"';
+        for (auto c: value) {
+            if ((c == '"') or (c == '\\')) {
+                os << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                os << escape;
+            } else {
+                os << c;
+            }
+        }
+        os << '"';
+    }
+
+} // namespace tango
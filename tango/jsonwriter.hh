@@ -0,0 +1,20 @@
+//
+//  jsonwriter.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+
+namespace tango {
+
+    /// Writes a string as a JSON string literal, escaping quotes,
+    /// backslashes and control characters.
+    void write_json_string(std::ostream& os, const std::string& value);
+
+} // namespace tango
@@ -6,163 +6,429 @@
 //  Copyright © 2017 University of Geneva. All rights reserved.
 //
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
-
-// Optimizations.
-#include <llvm/IR/LegacyPassManager.h>
-#include <llvm/Transforms/Scalar.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 
 #include "ast.hh"
+#include "astbinary.hh"
 #include "captureinfo.hh"
+#include "flatast.hh"
+#include "jit.hh"
+#include "memreport.hh"
+#include "optimizer.hh"
+#include "target.hh"
+#include "timereport.hh"
+#include "trace.hh"
 #include "types.hh"
+#include "analysis/captures.hh"
+#include "analysis/escapes.hh"
+#include "analysis/reachability.hh"
+#include "irgen/bitcodecache.hh"
+#include "irgen/codegen.hh"
 #include "irgen/irgen.hh"
 
 
-int main(int argc, char* argv[]) {
+static void print_usage(const char* argv0) {
+    std::cerr << "usage: " << argv0 << " [--run] [--flat] [--lazy] [--no-prune] [--no-lift] [--escaping-closures]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(argv0), ' ') << " [--cache-dir <dir>] [-j <threads>]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(argv0), ' ') << " [-O0|-O1|-O2|-O3|-Os] [--passes=<pipeline>] [-mcpu=<cpu>] [-o <output>]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(argv0), ' ') << " [--time-report[=<report.json>]] [--mem-report[=<report.json>]]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(argv0), ' ') << " [--trace=<trace.json>] <input>" << std::endl;
+    std::cerr << "       " << argv0 << " --convert <input.ast> <output>" << std::endl;
+}
+
+
+/// Parses a non-negative integer argument, or returns false if it isn't one.
+static bool parse_unsigned(const std::string& arg, unsigned& value) {
+    if (arg.empty() or (arg.find_first_not_of("0123456789") != std::string::npos)) {
+        return false;
+    }
+    try {
+        auto parsed = std::stoul(arg);
+        if (parsed > std::numeric_limits<unsigned>::max()) {
+            return false;
+        }
+        value = static_cast<unsigned>(parsed);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return true;
+}
+
+
+/// Loads an AST from either its JSON or its binary representation.
+static tango::Block* load_ast(
+    const std::string&           path,
+    tango::ASTContext&           context,
+    const tango::ASTReadOptions& options = tango::ASTReadOptions())
+{
+    if (tango::is_binary_ast(path)) {
+        return tango::read_binary_ast(path, context);
+    }
+    return tango::read_ast(path, context, options);
+}
+
+
+/// Ends a phase of a memory report, if there is one.
+static void end_memory_phase(tango::MemoryReport* mem_report, const char* phase) {
+    if (mem_report != nullptr) {
+        mem_report->end_phase(phase);
+    }
+}
+
+
+/// Loads an AST in its flat representation.
+///
+/// The pointer-based AST is released as soon as it has been flattened, in a
+/// phase of its own, which measures the teardown of its arena.
+static tango::FlatAST load_flat_ast(
+    const std::string&                     path,
+    const tango::ASTReadOptions&           options,
+    bool                                   prune,
+    const tango::analysis::CaptureOptions& capture_options,
+    tango::TimeReport*                     time_report,
+    tango::MemoryReport*                   mem_report)
+{
+    auto          context = std::make_unique<tango::ASTContext>();
+    tango::Block* ast;
+    {
+        tango::TimeReport::PhaseScope scope(time_report, "read");
+        ast = load_ast(path, *context, options);
+    }
+    end_memory_phase(mem_report, "read");
+    if (prune) {
+        {
+            tango::TimeReport::PhaseScope scope(time_report, "reachability");
+            tango::analysis::mark_reachable_functions(*ast);
+        }
+        end_memory_phase(mem_report, "reachability");
+    }
+    {
+        tango::TimeReport::PhaseScope scope(time_report, "captures");
+        tango::analysis::compute_capture_lists(*ast, capture_options);
+    }
+    end_memory_phase(mem_report, "captures");
+    {
+        tango::TimeReport::PhaseScope scope(time_report, "escapes");
+        tango::analysis::mark_escaping_closures(*ast);
+    }
+    end_memory_phase(mem_report, "escapes");
+
+    tango::FlatAST ret;
+    {
+        tango::TimeReport::PhaseScope scope(time_report, "flatten");
+        tango::MemoryCategoryScope    memory_scope(tango::mc_ast);
+        TANGO_TRACE_SCOPE(trace_scope, "flatten");
+        ret = tango::flatten_ast(*ast);
+    }
+    end_memory_phase(mem_report, "flatten");
+    {
+        tango::TimeReport::PhaseScope scope(time_report, "release");
+        TANGO_TRACE_SCOPE(trace_scope, "release");
+        context.reset();
+    }
+    end_memory_phase(mem_report, "release");
+    return ret;
+}
+
+
+/// Runs the compiler with the given command line, and returns its exit
+/// status.
+static int compile(int argc, char* argv[]) {
     using namespace tango;
 
-    std::ifstream ifs(argv[1]);
-    read_ast(ifs);
-    if (argc) { return 0; }
-
-    // Create a Tango program.
-    TypePtr Int     = tango::IntType::get();
-    TypePtr Int_p   = tango::RefType::get(Int);
-    TypePtr Int2Int = tango::FunctionType::get({Int}, {"x"}, {Int});
-    TypePtr Bool    = tango::BoolType::get();
-
-    // cst x: Int
-    // if true {
-    //     x = 5
-    // } else {
-    //     x = 10
-    // }
-    auto ast = Block({
-        new PropertyDecl("x"),
-        new If(
-            new BooleanLiteral(true),
-            new Block({
-                new Assignment(new Identifier("x"), tango::ao_cpy, new IntegerLiteral(5))
-            }),
-            new Block({
-                new Assignment(new Identifier("x"), tango::ao_cpy, new IntegerLiteral(10))
-            })),
-    });
-
-    ast.statements[0]->set_type(Int);
-
-    auto if_stmt = static_cast<If*>(ast.statements[1]);
-    if_stmt->condition->set_type(Bool);
-
-    auto x_assign = static_cast<Assignment*>(if_stmt->then_block->statements[0]);
-    x_assign->lvalue->set_type(Int);
-    x_assign->rvalue->set_type(Int);
-
-    x_assign = static_cast<Assignment*>(if_stmt->else_block->statements[0]);
-    x_assign->lvalue->set_type(Int);
-    x_assign->rvalue->set_type(Int);
-
-//    // def f(cst x: Int) -> Int {
-//    //     def g(cst y: Int) -> Int {
-//    //         return x
-//    //     }
-//    //     return g(y = 0)
-//    // }
-//    // f(x = 42)
-//    auto ast = Block({
-//        new FunctionDecl("f", {new ParamDecl("x")}, new Block({
-//            new FunctionDecl("g", {new ParamDecl("y")}, new Block({
-//                new Return(new Identifier("x")),
-//            })),
-//            new Return(
-//                new Call(new Identifier("g"), {new CallArg("y", tango::ao_cpy, new IntegerLiteral(0))})),
-//        })),
-//        new Call(new Identifier("f"), {new CallArg("x", tango::ao_cpy, new IntegerLiteral(42))})
-//    });
-//
-//    auto f_decl = static_cast<FunctionDecl*>(ast.statements[0]);
-//    f_decl->set_type(Int2Int);
-//    f_decl->parameters[0]->set_type(Int);
-//
-//    auto g_decl = static_cast<FunctionDecl*>(f_decl->body->statements[0]);
-//    g_decl->set_type(Int2Int);
-//    g_decl->parameters[0]->set_type(Int);
-//    g_decl->capture_list.push_back(CapturedValue(f_decl->parameters[0]));
-//    static_cast<Return*>(g_decl->body->statements[0])->value->set_type(Int);
-//
-//    auto f_return = static_cast<Return*>(f_decl->body->statements[1]);
-//    f_return->value->set_type(Int);
-//
-//    auto call_to_g = static_cast<Call*>(f_return->value);
-//    call_to_g->set_type(Int);
-//    call_to_g->callee->set_type(Int2Int);
-//    call_to_g->arguments[0]->value->set_type(Int);
-//
-//    auto call_to_f = static_cast<Call*>(ast.statements[1]);
-//    call_to_f->set_type(Int);
-//    call_to_f->callee->set_type(Int2Int);
-//    call_to_f->arguments[0]->value->set_type(Int);
-
-//    // def f(cst x: Int) -> Int {
-//    //     cst y = x
-//    //     return y
-//    // }
-//    auto ast = Block({
-//        (new FunctionDecl("f", {new ParamDecl("x")}, new Block({
-//            (new PropertyDecl("y"))->set_type(Int),
-//            new Assignment(
-//                (new Identifier("y"))->set_type(Int),
-//                tango::ao_cpy,
-//                (new Identifier("x"))->set_type(Int)),
-//            new Return((new Identifier("y"))->set_type(Int)),
-//        })))->set_type(Int2Int),
-//    });
-
-//    // mut z: Int
-//    // def f(cst x: Int) -> Int {
-//    //     mut y &- z
-//    //     y = x
-//    //     return y
-//    // }
-//    auto ast = Block({
-//        (new PropertyDecl("z"))->set_type(Int),
-//        (new FunctionDecl("f", {new ParamDecl("x")}, new Block({
-//            (new PropertyDecl("y"))->set_type(Int_p),
-//            new Assignment(
-//                (new Identifier("y"))->set_type(Int_p),
-//                tango::ao_ref,
-//                (new Identifier("z"))->set_type(Int)),
-//            new Assignment(
-//                (new Identifier("y"))->set_type(Int_p),
-//                tango::ao_cpy,
-//                (new Identifier("x"))->set_type(Int)),
-//            new Return((new Identifier("y"))->set_type(Int_p)),
-//        })))->set_type(Int2Int),
-//    });
-
-    // Create the module, which holds all the code.
-    llvm::LLVMContext context;
-    llvm::IRBuilder<> builder(context);
-    llvm::Module module("tango module", context);
-
-    // Generate the IR code of the module.
-    auto ir_generator = tango::irgen::IRGenerator(module, builder);
-    ir_generator.add_main_function();
-    ast.accept(ir_generator);
-    ir_generator.finish_main_function();
-
-    // Create an optimization pass manager.
-    auto pass_manager = llvm::make_unique<llvm::legacy::PassManager>();
-    pass_manager->add(llvm::createPromoteMemoryToRegisterPass());
-//    pass_manager->add(llvm::createInstructionCombiningPass());
-//    pass_manager->add(llvm::createReassociatePass());
-    pass_manager->run(module);
-
-    module.dump();
-
-    return 0;
+    // Convert JSON ASTs to their binary representation, so that subsequent
+    // compilations can skip JSON parsing altogether.
+    if ((argc == 4) and (std::string(argv[1]) == "--convert")) {
+        ASTContext ast_context;
+        auto ast = load_ast(argv[2], ast_context);
+        std::ofstream ofs(argv[3], std::ios::binary);
+        write_binary_ast(*ast, ofs);
+        return 0;
+    }
+
+    // Parse the command line.
+    bool                     run           = false;
+    bool                     use_flat_ast  = false;
+    bool                     prune         = true;
+    bool                     use_threads   = false;
+    ASTReadOptions           read_options;
+    analysis::CaptureOptions capture_options;
+    auto                     opt_level     = ol_O2;
+    std::string              pipeline;
+    std::string              cache_dir;
+    std::string              cpu;
+    std::string              output;
+    bool                     report_time   = false;
+    std::string              time_report_path;
+    bool                     report_memory = false;
+    std::string              mem_report_path;
+    std::string              trace_path;
+    std::string              input;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--run") {
+            // Compile the module in memory and execute it, rather than
+            // printing it.
+            run = true;
+        } else if (arg == "--flat") {
+            // Generate code from the flat representation of the AST, which
+            // only materializes one top-level statement at a time.
+            use_flat_ast = true;
+        } else if (arg == "--lazy") {
+            // Parse function bodies only when the IR generator gets to them.
+            read_options.lazy_bodies = true;
+        } else if (arg == "--no-prune") {
+            // Also generate the functions unreachable from the top-level
+            // statements.
+            prune = false;
+        } else if (arg == "--no-lift") {
+            // Never lambda lift nested functions, so that benchmarks can
+            // measure the costs of closures.
+            capture_options.lift_functions = false;
+        } else if (arg == "--escaping-closures") {
+            // Assume that all closures escape, and allocate their
+            // environments on the heap.
+            capture_options.assume_escaping = true;
+        } else if ((arg == "--cache-dir") and (i + 1 < argc)) {
+            // Cache the optimized bitcode of global functions in the given
+            // directory, and reuse it as long as their declarations don't
+            // change.
+            cache_dir = argv[++i];
+        } else if ((arg == "-j") and (i + 1 < argc)) {
+            // Load JSON ASTs and generate global functions on several
+            // threads, as many as there are cores with -j 0.
+            if (!parse_unsigned(argv[++i], read_options.thread_count)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            use_threads = true;
+        } else if ((arg == "-O0") or (arg == "-O1") or (arg == "-O2") or (arg == "-O3") or (arg == "-Os")) {
+            // Optimize with the default pipeline of the given level (-O2
+            // by default).
+            opt_level = parse_optimization_level(arg);
+        } else if (arg.compare(0, 9, "--passes=") == 0) {
+            // Optimize with a custom pipeline, in the syntax of opt (e.g.
+            // "function(mem2reg)").
+            pipeline = arg.substr(9);
+        } else if (arg.compare(0, 6, "-mcpu=") == 0) {
+            // Generate code for the given CPU rather than for the host CPU
+            // and its features.
+            cpu = arg.substr(6);
+        } else if (arg == "--time-report") {
+            // Print the costs of each phase and function to the standard
+            // error, and write them as JSON to the given file if any.
+            report_time = true;
+        } else if (arg.compare(0, 14, "--time-report=") == 0) {
+            report_time      = true;
+            time_report_path = arg.substr(14);
+        } else if (arg == "--mem-report") {
+            // Print the allocations and live bytes of each memory category
+            // at the end of each phase, and the peak resident set size, to
+            // the standard error, and write them as JSON to the given file
+            // if any.
+            report_memory = true;
+        } else if (arg.compare(0, 13, "--mem-report=") == 0) {
+            report_memory   = true;
+            mem_report_path = arg.substr(13);
+        } else if (arg.compare(0, 8, "--trace=") == 0) {
+            // Write a timeline of the compilation on each thread to the
+            // given file, in the Chrome trace-event format.
+            trace_path = arg.substr(8);
+        } else if ((arg == "-o") and (i + 1 < argc)) {
+            // Write the module to the given file, as an object, assembly or
+            // bitcode file depending on its extension (.o, .s, .bc), or as
+            // LLVM IR otherwise.
+            output = argv[++i];
+        } else if (input.empty() and (arg[0] != '-')) {
+            input = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (input.empty()
+        or (use_flat_ast and (use_threads or !cache_dir.empty()))
+        or (run and !output.empty()))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (read_options.thread_count == 0) {
+        read_options.thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    std::unique_ptr<TimeReport> time_report;
+    if (report_time) {
+        time_report = std::make_unique<TimeReport>();
+    }
+    std::unique_ptr<MemoryReport> mem_report;
+    if (report_memory) {
+        mem_report = std::make_unique<MemoryReport>();
+    }
+    if (!trace_path.empty()) {
+        trace::enable();
+    }
+
+    // The AST context owns all the nodes of the AST, and releases them at
+    // once when it goes out of scope.
+    ASTContext ast_context;
+    Block*     ast = nullptr;
+    FlatAST    flat_ast;
+    if (use_flat_ast) {
+        flat_ast = load_flat_ast(
+            input, read_options, prune, capture_options, time_report.get(), mem_report.get());
+    } else {
+        {
+            TimeReport::PhaseScope scope(time_report.get(), "read");
+            ast = load_ast(input, ast_context, read_options);
+        }
+        end_memory_phase(mem_report.get(), "read");
+        if (prune) {
+            {
+                TimeReport::PhaseScope scope(time_report.get(), "reachability");
+                analysis::mark_reachable_functions(*ast);
+            }
+            end_memory_phase(mem_report.get(), "reachability");
+        }
+        {
+            TimeReport::PhaseScope scope(time_report.get(), "captures");
+            analysis::compute_capture_lists(*ast, capture_options);
+        }
+        end_memory_phase(mem_report.get(), "captures");
+        {
+            TimeReport::PhaseScope scope(time_report.get(), "escapes");
+            analysis::mark_escaping_closures(*ast);
+        }
+        end_memory_phase(mem_report.get(), "escapes");
+    }
+
+    // Create the module, which holds all the code. Both are allocated on the
+    // heap, so that their ownership can be transferred to the JIT. The data
+    // layout of the target is set before generating any code, so that the
+    // optimizer knows the sizes and alignments of types. From then on,
+    // memory is accounted to LLVM, except for deferred bodies and nodes.
+    MemoryCategoryScope llvm_memory_scope(mc_llvm);
+    TargetDescription   target(cpu);
+    Optimizer           optimizer(target, opt_level, pipeline);
+    optimizer.time_report = time_report.get();
+    auto target_machine = create_target_machine(target, get_codegen_opt_level(optimizer.level));
+    auto optimize       = [&](llvm::Module& module) { optimizer.optimize(module); };
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module  = std::make_unique<llvm::Module>("tango module", *context);
+    module->setDataLayout(target_machine->createDataLayout());
+    module->setTargetTriple(target.triple);
+    llvm::IRBuilder<> builder(*context);
+
+    // Generate the IR code of the module, and optimize it. With threads or
+    // a cache, global functions are generated by units, whose output doesn't
+    // depend on the number of threads.
+    if (use_threads or !cache_dir.empty()) {
+        std::unique_ptr<irgen::BitcodeCache> cache;
+        irgen::SplitModuleOptions            split_options;
+        split_options.thread_count = read_options.thread_count;
+        split_options.time_report  = time_report.get();
+        if (!cache_dir.empty()) {
+            // Cache entries are per function, so that editing a function
+            // only invalidates its own entry. Entries are specific to the
+            // pipeline and to the target, whose data layout they're optimized
+            // for.
+            cache = std::make_unique<irgen::BitcodeCache>(cache_dir, optimizer.get_description());
+            split_options.unit_size = 1;
+            split_options.cache     = cache.get();
+        }
+
+        auto stats = irgen::generate_split_module(*ast, *module, split_options, optimize);
+        if (cache) {
+            std::cerr << "bitcode cache: " << stats.cache_hits << " hits, "
+                      << (stats.unit_count - stats.cache_hits) << " misses" << std::endl;
+        }
+        end_memory_phase(mem_report.get(), "codegen");
+    } else {
+        {
+            // The adapter is declared first, so that the nodes it materializes
+            // outlive the IR generator, which refers to them.
+            TimeReport::PhaseScope    scope(time_report.get(), "irgen");
+            FlatASTAdapter            flat_ast_adapter(flat_ast);
+            tango::irgen::IRGenerator ir_generator(*module, builder);
+            ir_generator.time_report = time_report.get();
+            ir_generator.add_main_function();
+            if (use_flat_ast) {
+                flat_ast_adapter.accept(ir_generator);
+            } else {
+                ast->accept(ir_generator);
+            }
+            ir_generator.finish_main_function();
+        }
+        end_memory_phase(mem_report.get(), "irgen");
+        optimizer.optimize(*module);
+        end_memory_phase(mem_report.get(), "optimize");
+    }
+
+    // The JIT phase includes the execution of the program.
+    int status = 0;
+    if (run) {
+        {
+            TimeReport::PhaseScope scope(time_report.get(), "jit");
+            TANGO_TRACE_SCOPE(trace_scope, "jit");
+            status = run_module(std::move(module), std::move(context), target, { input });
+        }
+        end_memory_phase(mem_report.get(), "jit");
+    } else {
+        {
+            TimeReport::PhaseScope scope(time_report.get(), "emit");
+            TANGO_TRACE_SCOPE(trace_scope, "emit");
+            if (!output.empty()) {
+                emit_module(*module, *target_machine, output, get_output_file_kind(output));
+            } else {
+                module->print(llvm::outs(), nullptr);
+            }
+        }
+        end_memory_phase(mem_report.get(), "emit");
+    }
+
+    if (time_report) {
+        time_report->print(std::cerr);
+        if (!time_report_path.empty()) {
+            std::ofstream ofs(time_report_path);
+            time_report->write_json(ofs);
+        }
+    }
+    if (mem_report) {
+        mem_report->print(std::cerr);
+        if (!mem_report_path.empty()) {
+            std::ofstream ofs(mem_report_path);
+            mem_report->write_json(ofs);
+        }
+    }
+    if (!trace_path.empty()) {
+        std::ofstream ofs(trace_path);
+        trace::write(ofs);
+    }
+    return status;
+}
+
+
+int main(int argc, char* argv[]) {
+    // Errors in the input, such as malformed ASTs or unsupported constructs,
+    // are reported rather than aborting the compiler.
+    try {
+        return compile(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": error: " << e.what() << std::endl;
+        return 1;
+    }
 }
@@ -0,0 +1,87 @@
+//
+//  mappedfile.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.hh"
+
+
+namespace tango {
+
+    MappedFile::MappedFile(const std::string& path): data(nullptr), size(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("cannot stat " + path);
+        }
+
+        this->size = static_cast<std::size_t>(st.st_size);
+        if (this->size > 0) {
+            void* addr = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("cannot map " + path);
+            }
+            this->data = static_cast<const std::uint8_t*>(addr);
+        }
+        close(fd);
+    }
+
+
+    MappedFile::~MappedFile() {
+        if (this->data != nullptr) {
+            munmap(const_cast<std::uint8_t*>(this->data), this->size);
+        }
+    }
+
+    // -----------------------------------------------------------------------
+
+    MemoryBuffer::MemoryBuffer(const std::uint8_t* data, std::size_t size) {
+        // The get area is never written to.
+        auto begin = reinterpret_cast<char*>(const_cast<std::uint8_t*>(data));
+        this->setg(begin, begin, begin + size);
+    }
+
+
+    MemoryBuffer::pos_type MemoryBuffer::seekoff(
+        off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+    {
+        if ((which & std::ios_base::in) == 0) {
+            return pos_type(off_type(-1));
+        }
+
+        off_type base = 0;
+        if (dir == std::ios_base::cur) {
+            base = this->gptr() - this->eback();
+        } else if (dir == std::ios_base::end) {
+            base = this->egptr() - this->eback();
+        }
+
+        off_type pos = base + off;
+        if ((pos < 0) or (pos > this->egptr() - this->eback())) {
+            return pos_type(off_type(-1));
+        }
+        this->setg(this->eback(), this->eback() + pos, this->egptr());
+        return pos_type(pos);
+    }
+
+
+    MemoryBuffer::pos_type MemoryBuffer::seekpos(pos_type pos, std::ios_base::openmode which) {
+        return this->seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+} // namespace tango
@@ -0,0 +1,44 @@
+//
+//  mappedfile.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+
+
+namespace tango {
+
+    /// A read-only memory mapping of a whole file.
+    struct MappedFile {
+
+        MappedFile(const std::string& path);
+        MappedFile(const MappedFile&) = delete;
+        ~MappedFile();
+
+        const std::uint8_t* data;
+        std::size_t         size;
+
+    };
+
+    /// Stream buffer reading from a region of memory, such as a mapped file.
+    ///
+    /// Unlike file buffers, seeking is as cheap as moving a pointer.
+    struct MemoryBuffer: public std::streambuf {
+
+        MemoryBuffer(const std::uint8_t* data, std::size_t size);
+
+    protected:
+
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+    };
+
+} // namespace tango
@@ -0,0 +1,137 @@
+//
+//  memreport.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "jsonwriter.hh"
+#include "memreport.hh"
+
+
+namespace tango {
+
+    std::uint64_t get_rss_bytes() {
+        // The second field of statm is the number of resident pages.
+        std::ifstream statm("/proc/self/statm");
+        std::uint64_t size, resident;
+        if (statm >> size >> resident) {
+            return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+        }
+        return 0;
+    }
+
+
+    std::uint64_t get_peak_rss_bytes() {
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+#if defined(__APPLE__)
+        return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+        // Linux reports the peak in kilobytes.
+        return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    // -----------------------------------------------------------------------
+
+    MemoryReport::MemoryReport() {
+        enable_memory_accounting();
+        reset_peak_live_bytes();
+        for (int category = 0; category <= mc_count; ++category) {
+            this->previous.push_back(get_memory_counters(static_cast<MemoryCategory>(category)));
+        }
+    }
+
+
+    void MemoryReport::end_phase(const std::string& name) {
+        Phase phase;
+        phase.name = name;
+        for (int category = 0; category <= mc_count; ++category) {
+            auto counters = get_memory_counters(static_cast<MemoryCategory>(category));
+            auto& start   = this->previous[category];
+
+            CategoryUsage usage;
+            usage.allocations     = counters.allocations     - start.allocations;
+            usage.allocated_bytes = counters.allocated_bytes - start.allocated_bytes;
+            usage.live_bytes      = counters.live_bytes;
+            usage.peak_live_bytes = counters.peak_live_bytes;
+            phase.categories.push_back(usage);
+            start = counters;
+        }
+        // The peak reported by the kernel may lag behind the current size.
+        phase.rss_bytes      = get_rss_bytes();
+        phase.peak_rss_bytes = std::max(get_peak_rss_bytes(), phase.rss_bytes);
+        this->phases.push_back(std::move(phase));
+
+        // Start measuring the peak of the next phase.
+        reset_peak_live_bytes();
+    }
+
+
+    void MemoryReport::print(std::ostream& os) const {
+        auto flags = os.flags();
+        os << std::fixed << std::setprecision(2);
+
+        os << "===== memory (MiB) =====" << std::endl;
+        os << std::left << std::setw(16) << "phase" << std::setw(8) << "category" << std::right
+           << std::setw(14) << "allocations" << std::setw(12) << "allocated"
+           << std::setw(12) << "live" << std::setw(12) << "peak live" << std::endl;
+        for (auto& phase: this->phases) {
+            for (int category = 0; category <= mc_count; ++category) {
+                auto& usage = phase.categories[category];
+                // Only list the categories that allocated during the phase.
+                if ((usage.allocations == 0) and (category != mc_count)) {
+                    continue;
+                }
+                os << std::left << std::setw(16) << phase.name
+                   << std::setw(8) << get_memory_category_name(static_cast<MemoryCategory>(category))
+                   << std::right << std::setw(14) << usage.allocations
+                   << std::setw(12) << usage.allocated_bytes / 1048576.0
+                   << std::setw(12) << usage.live_bytes      / 1048576.0
+                   << std::setw(12) << usage.peak_live_bytes / 1048576.0 << std::endl;
+            }
+            os << std::left << std::setw(16) << phase.name << std::setw(8) << "rss" << std::right
+               << std::setw(14) << "" << std::setw(12) << ""
+               << std::setw(12) << phase.rss_bytes      / 1048576.0
+               << std::setw(12) << phase.peak_rss_bytes / 1048576.0 << std::endl;
+        }
+        os << "peak rss: " << get_peak_rss_bytes() / 1048576.0 << " MiB" << std::endl;
+
+        os.flags(flags);
+    }
+
+
+    void MemoryReport::write_json(std::ostream& os) const {
+        os << "{\"phases\":[";
+        for (std::size_t i = 0; i < this->phases.size(); ++i) {
+            auto& phase = this->phases[i];
+            os << ((i > 0) ? "," : "") << "{\"name\":";
+            write_json_string(os, phase.name);
+            os << ",\"rss_bytes\":"      << phase.rss_bytes
+               << ",\"peak_rss_bytes\":" << phase.peak_rss_bytes
+               << ",\"categories\":[";
+            for (int category = 0; category <= mc_count; ++category) {
+                auto& usage = phase.categories[category];
+                os << ((category > 0) ? "," : "") << "{\"name\":\""
+                   << get_memory_category_name(static_cast<MemoryCategory>(category)) << "\""
+                   << ",\"allocations\":"     << usage.allocations
+                   << ",\"allocated_bytes\":" << usage.allocated_bytes
+                   << ",\"live_bytes\":"      << usage.live_bytes
+                   << ",\"peak_live_bytes\":" << usage.peak_live_bytes << "}";
+            }
+            os << "]}";
+        }
+        os << "],\"peak_rss_bytes\":" << get_peak_rss_bytes() << "}" << std::endl;
+    }
+
+} // namespace tango
@@ -0,0 +1,79 @@
+//
+//  memreport.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "allocstats.hh"
+
+
+namespace tango {
+
+    /// Returns the resident set size of the process in bytes, or 0 if it
+    /// can't be determined on this platform.
+    std::uint64_t get_rss_bytes();
+
+    /// Returns the peak resident set size of the process in bytes.
+    std::uint64_t get_peak_rss_bytes();
+
+    /// Report of the memory used by each category of data structures, at
+    /// the end of each phase of a compilation.
+    ///
+    /// Creating a report enables memory accounting. Phases are delimited by
+    /// calls to #end_phase, so each phase accounts the allocations made
+    /// since the end of the previous one, and the peak of the live bytes in
+    /// between.
+    struct MemoryReport {
+
+        /// Memory used by a category during a phase.
+        struct CategoryUsage {
+
+            /// Allocations made during the phase.
+            std::uint64_t allocations;
+            std::uint64_t allocated_bytes;
+
+            /// Live bytes at the end of the phase, and their peak during it.
+            std::int64_t  live_bytes;
+            std::int64_t  peak_live_bytes;
+
+        };
+
+        struct Phase {
+            std::string                name;
+            std::vector<CategoryUsage> categories;
+            std::uint64_t              rss_bytes;
+            std::uint64_t              peak_rss_bytes;
+        };
+
+        MemoryReport();
+        MemoryReport(const MemoryReport&) = delete;
+
+        /// Records the memory used since the end of the previous phase.
+        void end_phase(const std::string& name);
+
+        /// Prints the report in a human readable form.
+        void print(std::ostream& os) const;
+
+        /// Writes the report as a JSON object.
+        void write_json(std::ostream& os) const;
+
+    private:
+
+        /// The phases, in the order they ended.
+        std::vector<Phase> phases;
+
+        /// Counters at the end of the previous phase, indexed by category,
+        /// the last one being the total.
+        std::vector<MemoryCounters> previous;
+
+    };
+
+} // namespace tango
@@ -0,0 +1,319 @@
+//
+//  optimizer.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/LazyCallGraph.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/ADT/Any.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "optimizer.hh"
+#include "timereport.hh"
+#include "trace.hh"
+
+
+namespace tango {
+
+    OptimizationLevel parse_optimization_level(const std::string& option) {
+        if (option == "-O0") {
+            return ol_O0;
+        } else if (option == "-O1") {
+            return ol_O1;
+        } else if (option == "-O2") {
+            return ol_O2;
+        } else if (option == "-O3") {
+            return ol_O3;
+        } else if (option == "-Os") {
+            return ol_Os;
+        }
+        throw std::invalid_argument("unknown optimization level " + option);
+    }
+
+
+    llvm::CodeGenOpt::Level get_codegen_opt_level(OptimizationLevel level) {
+        switch (level) {
+            case ol_O0: return llvm::CodeGenOpt::None;
+            case ol_O1: return llvm::CodeGenOpt::Less;
+            case ol_O3: return llvm::CodeGenOpt::Aggressive;
+            default:    return llvm::CodeGenOpt::Default;
+        }
+    }
+
+
+    static const llvm::OptimizationLevel& get_llvm_level(OptimizationLevel level) {
+        switch (level) {
+            case ol_O0: return llvm::OptimizationLevel::O0;
+            case ol_O1: return llvm::OptimizationLevel::O1;
+            case ol_O2: return llvm::OptimizationLevel::O2;
+            case ol_O3: return llvm::OptimizationLevel::O3;
+            case ol_Os: return llvm::OptimizationLevel::Os;
+        }
+        throw std::invalid_argument("unknown optimization level");
+    }
+
+
+    static const char* get_level_name(OptimizationLevel level) {
+        switch (level) {
+            case ol_O0: return "O0";
+            case ol_O1: return "O1";
+            case ol_O2: return "O2";
+            case ol_O3: return "O3";
+            case ol_Os: return "Os";
+        }
+        throw std::invalid_argument("unknown optimization level");
+    }
+
+    /// Returns the names of the functions a pass runs on.
+    ///
+    /// Module passes aren't attributed to any particular function.
+    static std::vector<std::string> get_pass_functions(const llvm::Any& ir) {
+        std::vector<std::string> ret;
+        if (llvm::any_isa<const llvm::Function*>(ir)) {
+            ret.push_back(llvm::any_cast<const llvm::Function*>(ir)->getName().str());
+        } else if (llvm::any_isa<const llvm::Loop*>(ir)) {
+            auto loop = llvm::any_cast<const llvm::Loop*>(ir);
+            ret.push_back(loop->getHeader()->getParent()->getName().str());
+        } else if (llvm::any_isa<const llvm::LazyCallGraph::SCC*>(ir)) {
+            for (auto& node: *llvm::any_cast<const llvm::LazyCallGraph::SCC*>(ir)) {
+                ret.push_back(node.getFunction().getName().str());
+            }
+        }
+        return ret;
+    }
+
+
+    /// Collects the costs of the functions of a module during its
+    /// optimization.
+    ///
+    /// Passes are nested (e.g. function passes run within the adaptor that
+    /// runs them on every function of a module), so each one is accounted
+    /// the time it spent outside of the passes it ran.
+    struct FunctionCostCollector {
+
+        struct Frame {
+            std::vector<std::string>              functions;
+            std::chrono::steady_clock::time_point start;
+            double                                nested_seconds;
+        };
+
+        FunctionCostCollector(llvm::PassInstrumentationCallbacks& callbacks) {
+            callbacks.registerBeforeNonSkippedPassCallback([this](llvm::StringRef, llvm::Any ir) {
+                Frame frame = { get_pass_functions(ir), std::chrono::steady_clock::now(), 0 };
+                this->frames.push_back(std::move(frame));
+            });
+            callbacks.registerAfterPassCallback(
+                [this](llvm::StringRef, llvm::Any, const llvm::PreservedAnalyses&) {
+                    this->pop_frame();
+                });
+            callbacks.registerAfterPassInvalidatedCallback(
+                [this](llvm::StringRef, const llvm::PreservedAnalyses&) {
+                    this->pop_frame();
+                });
+        }
+
+        void pop_frame() {
+            auto&  frame   = this->frames.back();
+            double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - frame.start).count();
+            double self_seconds = seconds - frame.nested_seconds;
+            for (auto& function: frame.functions) {
+                this->costs[function].pass_seconds += self_seconds / frame.functions.size();
+            }
+
+            this->frames.pop_back();
+            if (!this->frames.empty()) {
+                this->frames.back().nested_seconds += seconds;
+            }
+        }
+
+        /// Counts the instructions of the functions defined in a module.
+        void count_instructions(const llvm::Module& module, bool is_optimized) {
+            for (auto& function: module) {
+                if (function.isDeclaration()) {
+                    continue;
+                }
+                auto& cost = this->costs[function.getName().str()];
+                (is_optimized ? cost.instructions_after : cost.instructions_before) =
+                    function.getInstructionCount();
+            }
+        }
+
+        std::vector<Frame>                  frames;
+        std::map<std::string, FunctionCost> costs;
+
+    };
+
+#if TANGO_ENABLE_TRACING
+    /// Records an event for each pass run, whose detail names the function
+    /// or module it ran on.
+    struct PassTracer {
+
+        struct Frame {
+            std::string   detail;
+            std::uint64_t start;
+        };
+
+        PassTracer(llvm::PassInstrumentationCallbacks& callbacks) {
+            callbacks.registerBeforeNonSkippedPassCallback([this](llvm::StringRef, llvm::Any ir) {
+                std::string detail;
+                if (llvm::any_isa<const llvm::Module*>(ir)) {
+                    detail = llvm::any_cast<const llvm::Module*>(ir)->getModuleIdentifier();
+                }
+                for (auto& function: get_pass_functions(ir)) {
+                    detail += (detail.empty() ? "" : " ") + function;
+                }
+                Frame frame = { std::move(detail), trace::now() };
+                this->frames.push_back(std::move(frame));
+            });
+            callbacks.registerAfterPassCallback(
+                [this](llvm::StringRef pass, llvm::Any, const llvm::PreservedAnalyses&) {
+                    this->pop_frame(pass);
+                });
+            callbacks.registerAfterPassInvalidatedCallback(
+                [this](llvm::StringRef pass, const llvm::PreservedAnalyses&) {
+                    this->pop_frame(pass);
+                });
+        }
+
+        void pop_frame(llvm::StringRef pass) {
+            trace::record(pass.str(), this->frames.back().detail, this->frames.back().start);
+            this->frames.pop_back();
+        }
+
+        std::vector<Frame> frames;
+
+    };
+#endif
+
+    // -----------------------------------------------------------------------
+
+    Optimizer::Optimizer(
+        const TargetDescription& target,
+        OptimizationLevel        level,
+        const std::string&       pipeline):
+        target(target),
+        level(level),
+        pipeline(pipeline),
+        time_report(nullptr)
+    {
+        // Parse custom pipelines upfront, so that errors are reported before
+        // any code is generated.
+        if (!pipeline.empty()) {
+            llvm::PassBuilder       pass_builder;
+            llvm::ModulePassManager pass_manager;
+            if (auto error = pass_builder.parsePassPipeline(pass_manager, pipeline)) {
+                throw std::invalid_argument(
+                    "invalid pass pipeline: " + llvm::toString(std::move(error)));
+            }
+        }
+    }
+
+
+    Optimizer::~Optimizer() = default;
+
+
+    void Optimizer::optimize(llvm::Module& module) const {
+        TimeReport::PhaseScope scope(this->time_report, "optimize");
+        TANGO_TRACE_SCOPE(trace_scope, "optimize");
+        TANGO_TRACE_DETAIL(trace_scope, module.getModuleIdentifier());
+        auto target_machine = this->acquire_target_machine();
+        {
+            llvm::PassInstrumentationCallbacks     callbacks;
+            std::unique_ptr<FunctionCostCollector> collector;
+            if (this->time_report != nullptr) {
+                collector = std::make_unique<FunctionCostCollector>(callbacks);
+                collector->count_instructions(module, false);
+            }
+#if TANGO_ENABLE_TRACING
+            std::unique_ptr<PassTracer> tracer;
+            if (trace::is_enabled()) {
+                tracer = std::make_unique<PassTracer>(callbacks);
+            }
+#endif
+
+            // Analysis managers must be destroyed before the pass builder,
+            // and their passes before the managers they refer to.
+            llvm::PassBuilder pass_builder(
+                target_machine.get(), llvm::PipelineTuningOptions(), llvm::None, &callbacks);
+
+            llvm::LoopAnalysisManager     loop_analyses;
+            llvm::FunctionAnalysisManager function_analyses;
+            llvm::CGSCCAnalysisManager    cgscc_analyses;
+            llvm::ModuleAnalysisManager   module_analyses;
+
+            function_analyses.registerPass([&] { return pass_builder.buildDefaultAAPipeline(); });
+            pass_builder.registerModuleAnalyses(module_analyses);
+            pass_builder.registerCGSCCAnalyses(cgscc_analyses);
+            pass_builder.registerFunctionAnalyses(function_analyses);
+            pass_builder.registerLoopAnalyses(loop_analyses);
+            pass_builder.crossRegisterProxies(
+                loop_analyses, function_analyses, cgscc_analyses, module_analyses);
+
+            llvm::ModulePassManager pass_manager;
+            if (!this->pipeline.empty()) {
+                if (auto error = pass_builder.parsePassPipeline(pass_manager, this->pipeline)) {
+                    throw std::invalid_argument(
+                        "invalid pass pipeline: " + llvm::toString(std::move(error)));
+                }
+            } else if (this->level == ol_O0) {
+                pass_manager = pass_builder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+            } else {
+                pass_manager = pass_builder.buildPerModuleDefaultPipeline(get_llvm_level(this->level));
+            }
+            pass_manager.run(module, module_analyses);
+
+            if (collector) {
+                collector->count_instructions(module, true);
+                for (auto& cost: collector->costs) {
+                    this->time_report->add_function_cost(cost.first, cost.second);
+                }
+            }
+        }
+        this->release_target_machine(std::move(target_machine));
+    }
+
+
+    std::string Optimizer::get_description() const {
+        return (this->pipeline.empty() ? get_level_name(this->level) : this->pipeline)
+            + " " + this->target.triple + " " + this->target.cpu + " " + this->target.features;
+    }
+
+
+    std::unique_ptr<llvm::TargetMachine> Optimizer::acquire_target_machine() const {
+        {
+            std::lock_guard<std::mutex> lock(this->target_machines_mutex);
+            if (!this->target_machines.empty()) {
+                auto target_machine = std::move(this->target_machines.back());
+                this->target_machines.pop_back();
+                return target_machine;
+            }
+        }
+        return create_target_machine(this->target, get_codegen_opt_level(this->level));
+    }
+
+
+    void Optimizer::release_target_machine(std::unique_ptr<llvm::TargetMachine> target_machine) const {
+        std::lock_guard<std::mutex> lock(this->target_machines_mutex);
+        this->target_machines.push_back(std::move(target_machine));
+    }
+
+} // namespace tango
@@ -0,0 +1,99 @@
+//
+//  optimizer.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <llvm/Support/CodeGen.h>
+
+#include "target.hh"
+
+
+namespace llvm {
+
+    class Module;
+    class TargetMachine;
+
+} // namespace llvm
+
+
+namespace tango {
+
+    struct TimeReport;
+
+    /// Optimization levels, as selected by -O0, -O1, -O2, -O3 and -Os.
+    enum OptimizationLevel {
+        ol_O0, ol_O1, ol_O2, ol_O3, ol_Os,
+    };
+
+    /// Returns the optimization level of a -O option (e.g. "-O2").
+    ///
+    /// Throws std::invalid_argument if the option isn't one of the supported
+    /// levels.
+    OptimizationLevel parse_optimization_level(const std::string& option);
+
+    /// Returns the level at which the backend optimizes machine code for the
+    /// given optimization level.
+    llvm::CodeGenOpt::Level get_codegen_opt_level(OptimizationLevel level);
+
+    /// Optimizer running a pipeline of the new pass manager on modules.
+    ///
+    /// The pipeline is either the default one of an optimization level, or
+    /// a custom textual pipeline (e.g. "function(mem2reg,instcombine)"), in
+    /// the syntax of opt's -passes option. The per-function simplification
+    /// passes of default pipelines run on every function of the module, so
+    /// that nested functions, which are private to their module, are
+    /// optimized along with (and possibly inlined into) global functions.
+    ///
+    /// Modules may be optimized from several threads at once, as long as
+    /// they belong to different LLVM contexts. Each thread then borrows a
+    /// target machine of its own, as target machines cache their subtargets
+    /// without synchronization.
+    struct Optimizer {
+
+        /// Creates an optimizer for the given target.
+        ///
+        /// Throws std::invalid_argument if the custom pipeline can't be
+        /// parsed.
+        Optimizer(
+            const TargetDescription& target,
+            OptimizationLevel        level,
+            const std::string&       pipeline = "");
+
+        ~Optimizer();
+
+        /// Optimizes a module.
+        void optimize(llvm::Module& module) const;
+
+        /// Returns a description of the pipeline, which identifies the code
+        /// it produces for a given input (e.g. in cache keys).
+        std::string get_description() const;
+
+        const TargetDescription target;
+        const OptimizationLevel level;
+        const std::string       pipeline;
+
+        /// The report to which the costs of the passes are added, or nullptr
+        /// if they aren't measured.
+        TimeReport* time_report;
+
+    private:
+
+        std::unique_ptr<llvm::TargetMachine> acquire_target_machine() const;
+        void release_target_machine(std::unique_ptr<llvm::TargetMachine> target_machine) const;
+
+        /// Target machines not borrowed by any thread.
+        mutable std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines;
+        mutable std::mutex                                        target_machines_mutex;
+
+    };
+
+} // namespace tango
@@ -0,0 +1,84 @@
+//
+//  runtime.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "runtime.hh"
+
+
+namespace {
+
+    /// Sizes are rounded up to a multiple of the granularity, which is also
+    /// the alignment of blocks.
+    const std::size_t granularity = 16;
+
+    /// Blocks larger than this are allocated with malloc.
+    const std::size_t max_arena_size = 512;
+
+    /// Size of the chunks from which arenas carve their blocks.
+    const std::size_t chunk_size = 64 * 1024;
+
+    /// The arena of a thread.
+    ///
+    /// Blocks are carved from the current chunk, and chunks are never given
+    /// back to the system, as blocks are never freed.
+    struct Arena {
+        char*         cursor;
+        char*         end;
+        std::uint64_t heap_size;
+    };
+
+    /// Arenas are zero-initialized, so that they need no constructor.
+    thread_local Arena arena;
+
+    /// Rounds a size up to the granularity. Empty blocks take a granule, so
+    /// that blocks have distinct addresses.
+    std::size_t get_block_size(std::uint64_t size) {
+        return (size > 0) ? ((size - 1) / granularity + 1) * granularity : granularity;
+    }
+
+} // namespace
+
+
+// Generated code doesn't unwind, so allocation failures abort rather than
+// throw.
+extern "C" {
+
+    void* tango_alloc(std::uint64_t size) {
+        if (size > max_arena_size) {
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr, granularity, size) != 0) {
+                std::abort();
+            }
+            arena.heap_size += size;
+            return ptr;
+        }
+
+        // Carve the block from the current chunk, starting a new one if it's
+        // exhausted. The remainder of the previous chunk is lost.
+        auto block_size = get_block_size(size);
+        if (static_cast<std::size_t>(arena.end - arena.cursor) < block_size) {
+            void* chunk = nullptr;
+            if (posix_memalign(&chunk, granularity, chunk_size) != 0) {
+                std::abort();
+            }
+            arena.cursor     = static_cast<char*>(chunk);
+            arena.end        = arena.cursor + chunk_size;
+            arena.heap_size += chunk_size;
+        }
+        auto block = arena.cursor;
+        arena.cursor += block_size;
+        return block;
+    }
+
+
+    std::uint64_t tango_heap_size() {
+        return arena.heap_size;
+    }
+
+}
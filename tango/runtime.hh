@@ -0,0 +1,40 @@
+//
+//  runtime.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+
+
+/// Functions called by generated code.
+///
+/// They're linked into the compiler, which provides them to the modules it
+/// runs with --run, and must be linked with the objects it emits otherwise.
+/// This file doesn't depend on the rest of the compiler, so that it can be
+/// compiled on its own.
+extern "C" {
+
+    /// Allocates a block of memory that outlives the frame of its caller,
+    /// such as the environment of an escaping closure, or a box holding a
+    /// mutable variable it captures.
+    ///
+    /// Small blocks are carved from per-thread arenas, so that allocating
+    /// them is about as cheap as moving a pointer. Blocks are aligned on 16
+    /// bytes.
+    ///
+    /// Blocks are never freed: generated code can't tell when the last
+    /// closure referring to a block dies, as there is no garbage collector.
+    /// They thus live until the process exits, and the memory used by a
+    /// program grows with the number of escaping closures it creates.
+    void* tango_alloc(std::uint64_t size);
+
+    /// Returns the number of bytes tango_alloc took from the system on the
+    /// calling thread, which is the memory its blocks retain. This lets
+    /// benchmarks measure the growth of programs that create closures.
+    std::uint64_t tango_heap_size();
+
+}
@@ -0,0 +1,80 @@
+//
+//  symbol.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "symbol.hh"
+
+
+namespace tango {
+
+    /// The global string interner.
+    ///
+    /// Interned strings are stored in a deque, so that references to them
+    /// remain valid as the table grows. The interner may be used from
+    /// several threads at once.
+    struct SymbolTable {
+
+        SymbolTable() {
+            this->intern("");
+        }
+
+        std::uint32_t intern(const std::string& str) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            auto it = this->ids.find(str);
+            if (it != this->ids.end()) {
+                return it->second;
+            }
+
+            auto id = static_cast<std::uint32_t>(this->strings.size());
+            this->strings.push_back(str);
+            this->ids.emplace(str, id);
+            return id;
+        }
+
+        const std::string& str(std::uint32_t id) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->strings[id];
+        }
+
+        std::mutex                                     mutex;
+        std::deque<std::string>                        strings;
+        std::unordered_map<std::string, std::uint32_t> ids;
+
+    };
+
+    static SymbolTable& get_symbol_table() {
+        static SymbolTable table;
+        return table;
+    }
+
+
+    Symbol::Symbol(const std::string& str) {
+        // Each thread keeps the symbols it has already interned, so that
+        // threads loading ASTs concurrently rarely contend on the global
+        // table's lock.
+        static thread_local std::unordered_map<std::string, std::uint32_t> cache;
+
+        auto it = cache.find(str);
+        if (it != cache.end()) {
+            this->id = it->second;
+            return;
+        }
+
+        this->id = get_symbol_table().intern(str);
+        cache.emplace(str, this->id);
+    }
+
+
+    const std::string& Symbol::str() const {
+        return get_symbol_table().str(this->id);
+    }
+
+} // namespace tango
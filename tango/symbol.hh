@@ -0,0 +1,54 @@
+//
+//  symbol.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+
+namespace tango {
+
+    /// Compact identifier of an interned string.
+    ///
+    /// Symbols are produced by a global interner, so that two symbols are
+    /// equal if and only if they were created from equal strings. Comparing
+    /// and hashing symbols is thus as cheap as comparing and hashing 32-bit
+    /// integers. The default symbol denotes the empty string.
+    struct Symbol {
+
+        Symbol(): id(0) {}
+
+        /// Interns a string, and returns its symbol.
+        explicit Symbol(const std::string& str);
+        explicit Symbol(const char* str): Symbol(std::string(str)) {}
+
+        /// Returns the string from which the symbol was created.
+        const std::string& str() const;
+
+        bool operator==(Symbol other) const { return this->id == other.id; }
+        bool operator!=(Symbol other) const { return this->id != other.id; }
+        bool operator< (Symbol other) const { return this->id <  other.id; }
+
+        std::uint32_t id;
+
+    };
+
+} // namespace tango
+
+
+namespace std {
+
+    template<>
+    struct hash<tango::Symbol> {
+        std::size_t operator()(tango::Symbol symbol) const {
+            return std::hash<std::uint32_t>()(symbol.id);
+        }
+    };
+
+} // namespace std
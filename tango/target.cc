@@ -0,0 +1,132 @@
+//
+//  target.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <stdexcept>
+#include <system_error>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include "target.hh"
+
+
+namespace tango {
+
+    TargetDescription::TargetDescription(const std::string& cpu):
+        triple(llvm::sys::getDefaultTargetTriple()),
+        cpu(cpu)
+    {
+        if (!this->cpu.empty()) {
+            return;
+        }
+
+        // Enable the features the host CPU actually has, rather than the
+        // default ones of its family, as some models of a family lack
+        // some of its extensions (e.g. AVX-512).
+        this->cpu = llvm::sys::getHostCPUName().str();
+        llvm::StringMap<bool> host_features;
+        if (llvm::sys::getHostCPUFeatures(host_features)) {
+            llvm::SubtargetFeatures features;
+            for (auto& feature: host_features) {
+                features.AddFeature(feature.first(), feature.second);
+            }
+            this->features = features.getString();
+        }
+    }
+
+
+    std::unique_ptr<llvm::TargetMachine> create_target_machine(
+        const TargetDescription& target,
+        llvm::CodeGenOpt::Level  opt_level)
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        std::string error;
+        auto llvm_target = llvm::TargetRegistry::lookupTarget(target.triple, error);
+        if (llvm_target == nullptr) {
+            throw std::invalid_argument(error);
+        }
+
+        // Objects are position independent, so that they can be linked in
+        // executables by toolchains that default to PIE.
+        return std::unique_ptr<llvm::TargetMachine>(llvm_target->createTargetMachine(
+            target.triple, target.cpu, target.features, llvm::TargetOptions(),
+            llvm::Reloc::PIC_, llvm::None, opt_level));
+    }
+
+
+    OutputFileKind get_output_file_kind(const std::string& path) {
+        auto ext_pos = path.rfind('.');
+        auto ext     = (ext_pos != std::string::npos) ? path.substr(ext_pos) : "";
+        if (ext == ".o") {
+            return of_object;
+        } else if (ext == ".s") {
+            return of_assembly;
+        } else if (ext == ".bc") {
+            return of_bitcode;
+        }
+        return of_llvm_ir;
+    }
+
+
+    void emit_module(
+        llvm::Module&        module,
+        llvm::TargetMachine& target_machine,
+        const std::string&   path,
+        OutputFileKind       kind)
+    {
+        std::error_code ec;
+        auto flags = ((kind == of_object) or (kind == of_bitcode))
+            ? llvm::sys::fs::OF_None
+            : llvm::sys::fs::OF_Text;
+        llvm::raw_fd_ostream os(path, ec, flags);
+        if (ec) {
+            throw std::runtime_error("cannot open " + path + ": " + ec.message());
+        }
+
+        switch (kind) {
+            case of_llvm_ir:
+                module.print(os, nullptr);
+                break;
+
+            case of_bitcode:
+                llvm::WriteBitcodeToFile(module, os);
+                break;
+
+            case of_object:
+            case of_assembly: {
+                llvm::legacy::PassManager pass_manager;
+                auto file_type = (kind == of_object)
+                    ? llvm::CGFT_ObjectFile
+                    : llvm::CGFT_AssemblyFile;
+                if (target_machine.addPassesToEmitFile(pass_manager, os, nullptr, file_type)) {
+                    throw std::invalid_argument("the target can't emit this kind of file");
+                }
+                pass_manager.run(module);
+                break;
+            }
+        }
+
+        os.close();
+        if (os.has_error()) {
+            os.clear_error();
+            throw std::runtime_error("failed to write " + path);
+        }
+    }
+
+} // namespace tango
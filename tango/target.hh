@@ -0,0 +1,62 @@
+//
+//  target.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <llvm/Support/CodeGen.h>
+
+
+namespace llvm {
+
+    class Module;
+    class TargetMachine;
+
+} // namespace llvm
+
+
+namespace tango {
+
+    /// Description of the machine for which code is generated.
+    struct TargetDescription {
+
+        /// Describes the host, with the features of its CPU, unless a CPU
+        /// is given, in which case the default features of that CPU are
+        /// used instead.
+        TargetDescription(const std::string& cpu = "");
+
+        std::string triple;
+        std::string cpu;
+        std::string features;
+
+    };
+
+    /// Creates a target machine for the given target, which optimizes
+    /// machine code at the given level.
+    std::unique_ptr<llvm::TargetMachine> create_target_machine(
+        const TargetDescription& target,
+        llvm::CodeGenOpt::Level  opt_level = llvm::CodeGenOpt::Default);
+
+    /// Kinds of files emitted by the backend.
+    enum OutputFileKind {
+        of_object, of_assembly, of_llvm_ir, of_bitcode,
+    };
+
+    /// Returns the kind of file to emit for the given path, based on its
+    /// extension (.o, .s, .bc, and LLVM IR otherwise).
+    OutputFileKind get_output_file_kind(const std::string& path);
+
+    /// Writes a module to a file of the given kind.
+    void emit_module(
+        llvm::Module&        module,
+        llvm::TargetMachine& target_machine,
+        const std::string&   path,
+        OutputFileKind       kind);
+
+} // namespace tango
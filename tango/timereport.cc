@@ -0,0 +1,190 @@
+//
+//  timereport.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "allocstats.hh"
+#include "jsonwriter.hh"
+#include "timereport.hh"
+
+
+namespace tango {
+
+    Cost Cost::now() {
+        Cost ret;
+        ret.wall_seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+            ret.cpu_seconds = double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+        }
+
+        ret.allocated_bytes = get_thread_allocated_bytes();
+        return ret;
+    }
+
+
+    Cost& Cost::operator+=(const Cost& other) {
+        this->wall_seconds    += other.wall_seconds;
+        this->cpu_seconds     += other.cpu_seconds;
+        this->allocated_bytes += other.allocated_bytes;
+        return *this;
+    }
+
+
+    Cost& Cost::operator-=(const Cost& other) {
+        this->wall_seconds    -= other.wall_seconds;
+        this->cpu_seconds     -= other.cpu_seconds;
+        this->allocated_bytes -= other.allocated_bytes;
+        return *this;
+    }
+
+    // -----------------------------------------------------------------------
+
+    /// The innermost phase scope of the current thread.
+    static thread_local TimeReport::PhaseScope* current_scope = nullptr;
+
+    TimeReport::PhaseScope::PhaseScope(TimeReport* report, const char* phase):
+        report(report),
+        phase(phase),
+        parent(nullptr)
+    {
+        if (report != nullptr) {
+            this->parent  = current_scope;
+            current_scope = this;
+            this->start   = Cost::now();
+        }
+    }
+
+
+    TimeReport::PhaseScope::~PhaseScope() {
+        if (this->report == nullptr) {
+            return;
+        }
+
+        Cost elapsed = Cost::now();
+        elapsed -= this->start;
+        if (this->parent != nullptr) {
+            this->parent->nested += elapsed;
+        }
+        current_scope = this->parent;
+
+        elapsed -= this->nested;
+        this->report->add_phase_cost(this->phase, elapsed);
+    }
+
+    // -----------------------------------------------------------------------
+
+    void TimeReport::add_phase_cost(const std::string& phase, const Cost& cost) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = std::find_if(this->phases.begin(), this->phases.end(),
+            [&](const std::pair<std::string, Cost>& entry) { return entry.first == phase; });
+        if (it == this->phases.end()) {
+            this->phases.push_back(std::make_pair(phase, cost));
+        } else {
+            it->second += cost;
+        }
+    }
+
+
+    void TimeReport::add_function_cost(const std::string& function, const FunctionCost& cost) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto& entry = this->functions[function];
+        entry.irgen_seconds       += cost.irgen_seconds;
+        entry.pass_seconds        += cost.pass_seconds;
+        entry.instructions_before += cost.instructions_before;
+        entry.instructions_after  += cost.instructions_after;
+    }
+
+
+    void TimeReport::print(std::ostream& os) const {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto flags = os.flags();
+        os << std::fixed;
+
+        os << "===== phases =====" << std::endl;
+        os << std::left << std::setw(16) << "phase" << std::right
+           << std::setw(12) << "wall (s)" << std::setw(12) << "cpu (s)"
+           << std::setw(16) << "allocated (B)" << std::endl;
+        Cost total;
+        for (auto& phase: this->phases) {
+            os << std::left << std::setw(16) << phase.first << std::right << std::setprecision(4)
+               << std::setw(12) << phase.second.wall_seconds
+               << std::setw(12) << phase.second.cpu_seconds
+               << std::setw(16) << phase.second.allocated_bytes << std::endl;
+            total += phase.second;
+        }
+        os << std::left << std::setw(16) << "total" << std::right << std::setprecision(4)
+           << std::setw(12) << total.wall_seconds
+           << std::setw(12) << total.cpu_seconds
+           << std::setw(16) << total.allocated_bytes << std::endl;
+
+        // List the most expensive functions first.
+        std::vector<const std::pair<const std::string, FunctionCost>*> functions;
+        for (auto& function: this->functions) {
+            functions.push_back(&function);
+        }
+        std::stable_sort(functions.begin(), functions.end(), [](
+            const std::pair<const std::string, FunctionCost>* lhs,
+            const std::pair<const std::string, FunctionCost>* rhs)
+        {
+            return (lhs->second.irgen_seconds + lhs->second.pass_seconds)
+                 > (rhs->second.irgen_seconds + rhs->second.pass_seconds);
+        });
+
+        os << "===== functions =====" << std::endl;
+        os << std::right << std::setw(12) << "irgen (ms)" << std::setw(12) << "passes (ms)"
+           << std::setw(10) << "before" << std::setw(10) << "after" << "  function" << std::endl;
+        for (auto function: functions) {
+            os << std::setprecision(3)
+               << std::setw(12) << function->second.irgen_seconds * 1e3
+               << std::setw(12) << function->second.pass_seconds * 1e3
+               << std::setw(10) << function->second.instructions_before
+               << std::setw(10) << function->second.instructions_after
+               << "  " << function->first << std::endl;
+        }
+
+        os.flags(flags);
+    }
+
+
+    void TimeReport::write_json(std::ostream& os) const {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto precision = os.precision(9);
+
+        os << "{\"phases\":[";
+        for (std::size_t i = 0; i < this->phases.size(); ++i) {
+            auto& phase = this->phases[i];
+            os << ((i > 0) ? "," : "") << "{\"name\":";
+            write_json_string(os, phase.first);
+            os << ",\"wall_seconds\":"    << phase.second.wall_seconds
+               << ",\"cpu_seconds\":"     << phase.second.cpu_seconds
+               << ",\"allocated_bytes\":" << phase.second.allocated_bytes << "}";
+        }
+
+        os << "],\"functions\":[";
+        bool is_first = true;
+        for (auto& function: this->functions) {
+            os << (is_first ? "" : ",") << "{\"name\":";
+            write_json_string(os, function.first);
+            os << ",\"irgen_seconds\":"       << function.second.irgen_seconds
+               << ",\"pass_seconds\":"        << function.second.pass_seconds
+               << ",\"instructions_before\":" << function.second.instructions_before
+               << ",\"instructions_after\":"  << function.second.instructions_after << "}";
+            is_first = false;
+        }
+        os << "]}" << std::endl;
+
+        os.precision(precision);
+    }
+
+} // namespace tango
@@ -0,0 +1,112 @@
+//
+//  timereport.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace tango {
+
+    /// Costs of a piece of work: wall and CPU time, and bytes allocated.
+    struct Cost {
+
+        Cost(): wall_seconds(0), cpu_seconds(0), allocated_bytes(0) {}
+
+        /// Returns the current readings of the clocks and of the allocation
+        /// counter of the calling thread.
+        static Cost now();
+
+        Cost& operator+=(const Cost& other);
+        Cost& operator-=(const Cost& other);
+
+        double        wall_seconds;
+        double        cpu_seconds;
+        std::uint64_t allocated_bytes;
+
+    };
+
+    /// Costs of the compilation of a function.
+    ///
+    /// Nested functions are accounted separately from the functions that
+    /// declare them, under the name of their LLVM function.
+    struct FunctionCost {
+
+        FunctionCost():
+            irgen_seconds(0), pass_seconds(0), instructions_before(0), instructions_after(0) {}
+
+        /// Time spent generating the IR of the function.
+        double irgen_seconds;
+
+        /// Time spent in the passes that ran on the function, or on the
+        /// loops and call graph SCCs it's part of.
+        double pass_seconds;
+
+        /// Instruction counts before and after optimization.
+        std::size_t instructions_before;
+        std::size_t instructions_after;
+
+    };
+
+    /// Report of the costs of the phases of a compilation, and of the
+    /// compilation of each function.
+    ///
+    /// Costs are those of the threads that enter phases, gathered from all
+    /// threads. Those of a phase that runs on several threads are the sum of
+    /// what each thread spent in it, hence may exceed the wall time of the
+    /// whole compilation, while work that a phase hands off to threads of
+    /// its own (e.g. parsing with several threads) only shows in its wall
+    /// time.
+    struct TimeReport {
+
+        /// Scope that accounts the costs of the calling thread to a phase.
+        ///
+        /// Scopes may be nested, in which case the costs of the inner scope
+        /// are only accounted to its phase, so that phases don't overlap.
+        /// A null report disables the scope.
+        struct PhaseScope {
+
+            PhaseScope(TimeReport* report, const char* phase);
+            PhaseScope(const PhaseScope&) = delete;
+            ~PhaseScope();
+
+            TimeReport* report;
+            const char* phase;
+            Cost        start;
+            Cost        nested;
+            PhaseScope* parent;
+
+        };
+
+        /// Adds costs to a phase.
+        void add_phase_cost(const std::string& phase, const Cost& cost);
+
+        /// Adds costs to a function, merging them with its existing ones.
+        void add_function_cost(const std::string& function, const FunctionCost& cost);
+
+        /// Prints the report in a human readable form.
+        void print(std::ostream& os) const;
+
+        /// Writes the report as a JSON object.
+        void write_json(std::ostream& os) const;
+
+    private:
+
+        /// The phases, in the order they were first entered.
+        std::vector<std::pair<std::string, Cost>> phases;
+        std::map<std::string, FunctionCost>       functions;
+        mutable std::mutex                        mutex;
+
+    };
+
+} // namespace tango
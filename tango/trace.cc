@@ -0,0 +1,143 @@
+//
+//  trace.cc
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "jsonwriter.hh"
+#include "trace.hh"
+
+
+namespace tango {
+namespace trace {
+
+    struct Event {
+        std::string   name;
+        std::string   detail;
+        std::uint64_t start;
+        std::uint64_t end;
+    };
+
+    /// Events recorded by a thread.
+    struct ThreadBuffer {
+        std::uint32_t      tid;
+        std::vector<Event> events;
+    };
+
+    static std::atomic<bool> enabled(false);
+
+    /// Buffers of all the threads that recorded events, which outlive their
+    /// threads so that events are written once all threads are done.
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    static std::mutex                                 buffers_mutex;
+
+    static thread_local ThreadBuffer* thread_buffer = nullptr;
+
+    static ThreadBuffer& get_thread_buffer() {
+        if (thread_buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            thread_buffer      = buffers.back().get();
+            thread_buffer->tid = static_cast<std::uint32_t>(buffers.size());
+        }
+        return *thread_buffer;
+    }
+
+
+    void enable() {
+        enabled.store(true, std::memory_order_relaxed);
+    }
+
+
+    bool is_enabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+
+    std::uint64_t now() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+
+    void record(const std::string& name, const std::string& detail, std::uint64_t start) {
+        Event event = { name, detail, start, now() };
+        get_thread_buffer().events.push_back(std::move(event));
+    }
+
+
+    void write(std::ostream& os) {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+
+        // Timestamps are in microseconds, relative to the first event.
+        std::uint64_t origin = UINT64_MAX;
+        for (auto& buffer: buffers) {
+            for (auto& event: buffer->events) {
+                origin = std::min(origin, event.start);
+            }
+        }
+
+        auto precision = os.precision(15);
+        os << "{\"traceEvents\":[";
+        bool is_first = true;
+        for (auto& buffer: buffers) {
+            os << (is_first ? "" : ",")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+               << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+            is_first = false;
+
+            for (auto& event: buffer->events) {
+                os << ",{\"name\":";
+                write_json_string(os, event.name);
+                os << ",\"cat\":\"tango\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                   << ",\"ts\":"  << double(event.start - origin) / 1e3
+                   << ",\"dur\":" << double(event.end - event.start) / 1e3;
+                if (!event.detail.empty()) {
+                    os << ",\"args\":{\"detail\":";
+                    write_json_string(os, event.detail);
+                    os << "}";
+                }
+                os << "}";
+            }
+        }
+        os << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+        os.precision(precision);
+    }
+
+    // -----------------------------------------------------------------------
+
+    Scope::Scope(const char* name):
+        name(name),
+        start(0),
+        is_active(is_enabled())
+    {
+        if (this->is_active) {
+            this->start = now();
+        }
+    }
+
+
+    Scope::~Scope() {
+        if (this->is_active) {
+            record(this->name, this->detail, this->start);
+        }
+    }
+
+
+    void Scope::set_detail(const std::string& detail) {
+        if (this->is_active) {
+            this->detail = detail;
+        }
+    }
+
+} // namespace trace
+} // namespace tango
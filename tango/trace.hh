@@ -0,0 +1,77 @@
+//
+//  trace.hh
+//  tango
+//
+//  Copyright © 2017 University of Geneva. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+
+// Tracing is compiled in unless TANGO_ENABLE_TRACING is defined to 0, in
+// which case trace scopes expand to nothing, and their arguments aren't even
+// evaluated.
+#ifndef TANGO_ENABLE_TRACING
+#define TANGO_ENABLE_TRACING 1
+#endif
+
+#if TANGO_ENABLE_TRACING
+/// Declares a scope named `var` that records an event named `name`.
+#define TANGO_TRACE_SCOPE(var, name) ::tango::trace::Scope var(name)
+/// Sets the detail of the event of a scope (e.g. the name of a function).
+#define TANGO_TRACE_DETAIL(var, detail) var.set_detail(detail)
+#else
+#define TANGO_TRACE_SCOPE(var, name) ((void)0)
+#define TANGO_TRACE_DETAIL(var, detail) ((void)0)
+#endif
+
+
+namespace tango {
+namespace trace {
+
+    /// Starts recording the events of all threads.
+    void enable();
+
+    /// Returns whether events are being recorded.
+    bool is_enabled();
+
+    /// Writes the events recorded so far in the Chrome trace-event format,
+    /// which chrome://tracing and Perfetto can display.
+    ///
+    /// It shouldn't be called while other threads are recording events.
+    void write(std::ostream& os);
+
+    /// Records an event spanning the lifetime of the scope, on the timeline
+    /// of the calling thread.
+    ///
+    /// Events are buffered per thread, so recording doesn't synchronize
+    /// threads. Scopes created while tracing is disabled record nothing,
+    /// and only cost a check of a flag.
+    struct Scope {
+
+        Scope(const char* name);
+        Scope(const Scope&) = delete;
+        ~Scope();
+
+        void set_detail(const std::string& detail);
+
+        const char*   name;
+        std::string   detail;
+        std::uint64_t start;
+        bool          is_active;
+
+    };
+
+    /// Records an event that started at the given time, in nanoseconds on
+    /// the trace clock, and ends now.
+    void record(const std::string& name, const std::string& detail, std::uint64_t start);
+
+    /// Returns the current time in nanoseconds on the trace clock.
+    std::uint64_t now();
+
+} // namespace trace
+} // namespace tango
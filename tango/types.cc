@@ -6,19 +6,35 @@
 //  Copyright © 2017 University of Geneva. All rights reserved.
 //
 
+#include <functional>
+#include <mutex>
+
 #include <llvm/IR/DerivedTypes.h>
 
+#include "allocstats.hh"
 #include "types.hh"
 
 
 namespace tango {
 
+    TypePtr RefType::get(TypePtr rt) {
+        return TypeContext::get_global().get_ref_type(rt);
+    }
+
     llvm::Type* RefType::get_llvm_type(llvm::LLVMContext& ctx) const {
         return llvm::PointerType::getUnqual(this->referred_type->get_llvm_type(ctx));
     }
 
     // -----------------------------------------------------------------------
 
+    TypePtr FunctionType::get(
+        const std::vector<TypePtr>& domain,
+        const std::vector<Symbol>&  labels,
+        TypePtr                     codomain)
+    {
+        return TypeContext::get_global().get_function_type(domain, labels, codomain);
+    }
+
     llvm::Type* FunctionType::get_llvm_type(llvm::LLVMContext& ctx) const {
         std::vector<llvm::Type*> arg_types;
         for (auto ty: this->domain) {
@@ -40,19 +56,128 @@ namespace tango {
 
     // -----------------------------------------------------------------------
 
+    TypePtr IntType::get() {
+        return TypeContext::get_global().get_int_type();
+    }
+
     llvm::Type* IntType::get_llvm_type(llvm::LLVMContext& ctx) const {
         return llvm::Type::getInt64Ty(ctx);
     }
 
     // -----------------------------------------------------------------------
 
+    TypePtr BoolType::get() {
+        return TypeContext::get_global().get_bool_type();
+    }
+
     llvm::Type* BoolType::get_llvm_type(llvm::LLVMContext& ctx) const {
         return llvm::Type::getInt1Ty(ctx);
     }
 
     // -----------------------------------------------------------------------
 
-    TangoLLVMTypes::TangoLLVMTypes(llvm::LLVMContext& ctx) {
+    /// Key identifying a function type by its structure.
+    struct FunctionTypeKey {
+
+        bool operator==(const FunctionTypeKey& other) const {
+            return (this->domain   == other.domain)
+               and (this->labels   == other.labels)
+               and (this->codomain == other.codomain);
+        }
+
+        std::vector<TypePtr> domain;
+        std::vector<Symbol>  labels;
+        TypePtr              codomain;
+
+    };
+
+    struct FunctionTypeKeyHash {
+        std::size_t operator()(const FunctionTypeKey& key) const {
+            std::size_t h = std::hash<TypePtr>()(key.codomain);
+            for (auto ty: key.domain) {
+                h = h * 31 + std::hash<TypePtr>()(ty);
+            }
+            for (auto label: key.labels) {
+                h = h * 31 + std::hash<Symbol>()(label);
+            }
+            return h;
+        }
+    };
+
+    struct TypeContext::Impl {
+
+        /// Takes the ownership of a new type.
+        template<typename T>
+        TypePtr own(T* type) {
+            this->types.emplace_back(type);
+            return type;
+        }
+
+        typedef std::unordered_map<FunctionTypeKey, TypePtr, FunctionTypeKeyHash>
+            FunctionTypeTable;
+
+        std::mutex                             mutex;
+        std::vector<std::unique_ptr<TypeBase>> types;
+        std::unordered_map<TypePtr, TypePtr>   ref_types;
+        FunctionTypeTable                      function_types;
+
+    };
+
+    TypeContext::TypeContext() {
+        MemoryCategoryScope memory_scope(mc_types);
+        this->impl.reset(new Impl());
+        this->int_type  = this->impl->own(new IntType());
+        this->bool_type = this->impl->own(new BoolType());
+    }
+
+    TypeContext::~TypeContext() {}
+
+    TypePtr TypeContext::get_ref_type(TypePtr referred_type) {
+        MemoryCategoryScope         memory_scope(mc_types);
+        std::lock_guard<std::mutex> lock(this->impl->mutex);
+
+        auto it = this->impl->ref_types.find(referred_type);
+        if (it != this->impl->ref_types.end()) {
+            return it->second;
+        }
+
+        auto ret = this->impl->own(new RefType(referred_type));
+        this->impl->ref_types.emplace(referred_type, ret);
+        return ret;
+    }
+
+    TypePtr TypeContext::get_function_type(
+        const std::vector<TypePtr>& domain,
+        const std::vector<Symbol>&  labels,
+        TypePtr                     codomain)
+    {
+        MemoryCategoryScope memory_scope(mc_types);
+        FunctionTypeKey     key { domain, labels, codomain };
+        std::lock_guard<std::mutex> lock(this->impl->mutex);
+
+        auto it = this->impl->function_types.find(key);
+        if (it != this->impl->function_types.end()) {
+            return it->second;
+        }
+
+        auto ret = this->impl->own(new FunctionType(domain, labels, codomain));
+        this->impl->function_types.emplace(std::move(key), ret);
+        return ret;
+    }
+
+    std::size_t TypeContext::size() const {
+        std::lock_guard<std::mutex> lock(this->impl->mutex);
+        return this->impl->types.size();
+    }
+
+    TypeContext& TypeContext::get_global() {
+        static TypeContext context;
+        return context;
+    }
+
+    // -----------------------------------------------------------------------
+
+    TangoLLVMTypes::TangoLLVMTypes(llvm::LLVMContext& ctx): context(ctx) {
         // void* type.
         voidp_t = llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(ctx));
 
@@ -70,4 +195,27 @@ namespace tango {
         closure_t->setBody(members);
     }
 
+    llvm::Type* TangoLLVMTypes::get_llvm_type(TypePtr type) {
+        auto it = this->lowered.find(type);
+        if (it != this->lowered.end()) {
+            return it->second;
+        }
+
+        auto ret = type->get_llvm_type(this->context);
+        this->lowered.emplace(type, ret);
+        return ret;
+    }
+
+    llvm::FunctionType* TangoLLVMTypes::get_llvm_lifted_type(TypePtr type) {
+        auto it = this->lifted.find(type);
+        if (it != this->lifted.end()) {
+            return it->second;
+        }
+
+        auto fun_type = static_cast<const FunctionType*>(type);
+        auto ret = fun_type->get_llvm_lifted_type(this->context, this->closure_t);
+        this->lifted.emplace(type, ret);
+        return ret;
+    }
+
 } // namespace tango
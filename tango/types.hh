@@ -10,8 +10,11 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "symbol.hh"
+
 
 namespace llvm {
 
@@ -26,6 +29,11 @@ namespace llvm {
 
 namespace tango {
 
+    /// Base of all types.
+    ///
+    /// Types are unique: they are created once by the type context, and
+    /// are never modified afterwards, so that two types are structurally
+    /// equal if and only if they are the same object.
     struct TypeBase {
 
         virtual ~TypeBase() {}
@@ -38,7 +46,7 @@ namespace tango {
 
     };
 
-    typedef std::shared_ptr<TypeBase> TypePtr;
+    typedef const TypeBase* TypePtr;
 
     // -----------------------------------------------------------------------
 
@@ -54,9 +62,7 @@ namespace tango {
 
         TypePtr referred_type;
 
-        static TypePtr get(TypePtr rt) {
-            return std::make_shared<RefType>(rt);
-        }
+        static TypePtr get(TypePtr rt);
 
     };
 
@@ -81,9 +87,9 @@ namespace tango {
 
         FunctionType(const FunctionType&) = delete;
         FunctionType(
-            const std::vector<TypePtr>&     domain,
-            const std::vector<std::string>& labels,
-            TypePtr                         codomain):
+            const std::vector<TypePtr>& domain,
+            const std::vector<Symbol>&  labels,
+            TypePtr                     codomain):
             domain(domain), labels(labels), codomain(codomain) {}
 
         bool is_primitive() const { return false; }
@@ -97,17 +103,14 @@ namespace tango {
         llvm::FunctionType* get_llvm_lifted_type(
             llvm::LLVMContext&, llvm::StructType* closure_type) const;
 
-        std::vector<TypePtr>     domain;
-        std::vector<std::string> labels;
-        TypePtr                  codomain;
+        const std::vector<TypePtr> domain;
+        const std::vector<Symbol>  labels;
+        const TypePtr              codomain;
 
         static TypePtr get(
-            const std::vector<TypePtr>&     domain,
-            const std::vector<std::string>& labels,
-            TypePtr                         codomain)
-        {
-            return std::make_shared<FunctionType>(domain, labels, codomain);
-        }
+            const std::vector<TypePtr>& domain,
+            const std::vector<Symbol>&  labels,
+            TypePtr                     codomain);
 
     };
 
@@ -121,9 +124,7 @@ namespace tango {
 
         llvm::Type* get_llvm_type(llvm::LLVMContext&) const;
 
-        static TypePtr get() {
-            return std::make_shared<IntType>();
-        }
+        static TypePtr get();
 
     };
 
@@ -137,23 +138,78 @@ namespace tango {
 
         llvm::Type* get_llvm_type(llvm::LLVMContext&) const;
 
-        static TypePtr get() {
-            return std::make_shared<IntType>();
-        }
-        
+        static TypePtr get();
+
+    };
+
+    // -----------------------------------------------------------------------
+
+    /// Owns the unique instances of all types.
+    ///
+    /// The static `get` methods of the type classes look types up in the
+    /// global context, which may be used from several threads at once.
+    /// Types live as long as the program, so references to them never
+    /// dangle and never need to be counted.
+    struct TypeContext {
+
+        TypeContext();
+        TypeContext(const TypeContext&) = delete;
+        ~TypeContext();
+
+        TypePtr get_int_type()  const { return this->int_type; }
+        TypePtr get_bool_type() const { return this->bool_type; }
+
+        TypePtr get_ref_type(TypePtr referred_type);
+        TypePtr get_function_type(
+            const std::vector<TypePtr>& domain,
+            const std::vector<Symbol>&  labels,
+            TypePtr                     codomain);
+
+        /// Returns the number of unique types created so far.
+        std::size_t size() const;
+
+        /// Returns the global type context.
+        static TypeContext& get_global();
+
+    private:
+
+        struct Impl;
+        std::unique_ptr<Impl> impl;
+
+        TypePtr int_type;
+        TypePtr bool_type;
+
     };
 
     // -----------------------------------------------------------------------
 
+    /// LLVM types used by the IR generator, for a given LLVM context.
+    ///
+    /// Tango types are lowered at most once per instance, so that asking
+    /// for the LLVM type of a declaration is a single table lookup.
     struct TangoLLVMTypes {
 
         TangoLLVMTypes(llvm::LLVMContext&);
 
+        /// Returns the LLVM type of the given type.
+        llvm::Type* get_llvm_type(TypePtr type);
+
+        /// Returns the LLVM type of the given function type, with a pointer
+        /// to a closure instance as its first parameter.
+        llvm::FunctionType* get_llvm_lifted_type(TypePtr type);
+
+        llvm::LLVMContext& context;
+
         llvm::PointerType* voidp_t;
 
         llvm::Type*        integer_t;
         llvm::StructType*  closure_t;
 
+    private:
+
+        std::unordered_map<TypePtr, llvm::Type*>         lowered;
+        std::unordered_map<TypePtr, llvm::FunctionType*> lifted;
+
     };
 
 } // namespace tango
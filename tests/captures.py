@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+#
+#  captures.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Checks that nested functions read the values they capture, whether they
+are initialized before or after the nested functions are declared.
+
+Each case is a global function `f`, which returns its argument through a
+nested function that captures it, or a property it's assigned to, which may
+be the global property `g`. The top-level code of the module assigns `g`,
+and declares a property to call `f` with. Each case is compiled to an object
+in each of the modes of bench/closures.py, with and without --flat, linked
+with the runtime in a shared library, and `f` is called by a driver with a
+few arguments, which it must return.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'bench'))
+
+from gen_ast import INT, assignment, block, call, function_decl, identifier, literal, meta, property_decl
+
+
+MODES = {
+    'lifted': [],
+    'stack':  ['--no-lift'],
+    'heap':   ['--no-lift', '--escaping-closures'],
+}
+
+ARGUMENTS = [0, 1, 42, -7, 123456789]
+
+DRIVER = r'''
+#include <dlfcn.h>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char* argv[]) {
+    void* library = dlopen(argv[1], RTLD_NOW);
+    if (library == nullptr) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        return 1;
+    }
+    auto function = reinterpret_cast<long (*)(long)>(dlsym(library, "f"));
+    for (int i = 2; i < argc; ++i) {
+        std::printf("%ld\n", function(std::atol(argv[i])));
+    }
+    return 0;
+}
+'''
+
+
+def ret(value):
+    return {'Return': {'__meta__': meta(), 'value': value}}
+
+
+def mutable_decl(name):
+    ret = property_decl(name)
+    ret['PropertyDecl']['mutability'] = 'mut'
+    return ret
+
+
+def nested(name, statements):
+    """Declares a nested function `name`, and returns the result of calling
+    it with the argument of `f`.
+    """
+    return [function_decl(name, 'y', statements), ret(call(name, identifier('x', INT), 'y'))]
+
+
+CASES = {
+    'parameter': (
+        nested('g', [ret(identifier('x', INT))])),
+    'constant': (
+        [property_decl('a'), assignment('a', identifier('x', INT))]
+        + nested('g', [ret(identifier('a', INT))])),
+    'late constant': (
+        [property_decl('a'),
+         function_decl('g', 'y', [ret(identifier('a', INT))]),
+         assignment('a', identifier('x', INT)),
+         ret(call('g', identifier('x', INT), 'y'))]),
+    'late constant of a nested function': (
+        [property_decl('a'),
+         function_decl('g', 'y', [
+             function_decl('h', 'z', [ret(identifier('a', INT))]),
+             ret(call('h', identifier('y', INT), 'z'))]),
+         assignment('a', identifier('x', INT)),
+         ret(call('g', identifier('x', INT), 'y'))]),
+    'global': (
+        [assignment('g', identifier('x', INT))]
+        + nested('h', [ret(identifier('g', INT))])),
+    'late mutable': (
+        [mutable_decl('a'),
+         assignment('a', literal(0)),
+         function_decl('g', 'y', [ret(identifier('a', INT))]),
+         assignment('a', identifier('x', INT)),
+         ret(call('g', identifier('x', INT), 'y'))]),
+}
+
+
+def module(statements):
+    return {'ModuleDecl': {'__meta__': {}, 'name': 'main', 'body': block([
+        mutable_decl('g'),
+        function_decl('f', 'x', statements),
+        assignment('g', literal(1)),
+        property_decl('a'),
+        assignment('a', identifier('g', INT)),
+        call('f', identifier('a', INT))])}}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('tango', help='path to the tango binary')
+    parser.add_argument('--opt-level', default='2', choices=['0', '1', '2', '3', 's'])
+    parser.add_argument('--cxx', default=os.environ.get('CXX', 'c++'),
+                        help='C++ compiler used to build the runtime and the driver')
+    args = parser.parse_args()
+
+    root     = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    failures = 0
+
+    with tempfile.TemporaryDirectory() as workdir:
+        runtime = os.path.join(workdir, 'runtime.o')
+        driver  = os.path.join(workdir, 'driver')
+        with open(driver + '.cc', 'w') as f:
+            f.write(DRIVER)
+        subprocess.check_call([args.cxx, '-O2', '-o', driver, driver + '.cc', '-ldl'])
+        subprocess.check_call([args.cxx, '-O2', '-fPIC', '-c', '-o', runtime,
+                               os.path.join(root, 'tango', 'runtime.cc')])
+
+        for index, (name, statements) in enumerate(sorted(CASES.items())):
+            source = os.path.join(workdir, 'case%d.ast' % index)
+            with open(source, 'w') as f:
+                json.dump(module(statements), f)
+
+            for flags in [[], ['--flat']]:
+                for mode in ['lifted', 'stack', 'heap']:
+                    label   = ' '.join([mode] + flags)
+                    target  = os.path.join(workdir, 'case%d.o' % index)
+                    library = os.path.join(workdir, 'libcase%d-%s%d.so' % (index, mode, len(flags)))
+                    subprocess.check_call([args.tango, '-O%s' % args.opt_level] + MODES[mode] + flags
+                                          + ['-o', target, source])
+                    subprocess.check_call([args.cxx, '-shared', '-o', library, target, runtime])
+
+                    output = subprocess.check_output(
+                        [driver, library] + [str(argument) for argument in ARGUMENTS])
+                    results = [int(line) for line in output.split()]
+                    if results == ARGUMENTS:
+                        print('PASS %s (%s)' % (name, label))
+                    else:
+                        print('FAIL %s (%s): expected %s, got %s' % (name, label, ARGUMENTS, results))
+                        failures += 1
+
+    return 1 if failures > 0 else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
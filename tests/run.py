@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+#  run.py
+#  tango
+#
+#  Copyright © 2017 University of Geneva. All rights reserved.
+#
+
+"""Checks that modules run with --run.
+
+Each case is a module, which is compiled and run by the JIT in each of the
+modes of bench/closures.py, and must exit with a zero status, without any
+error from the compiler or the JIT.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'bench'))
+
+from gen_ast import INT, assignment, block, call, function_decl, identifier, literal, meta, property_decl
+
+
+MODES = {
+    'lifted': [],
+    'stack':  ['--no-lift'],
+    'heap':   ['--no-lift', '--escaping-closures'],
+}
+
+
+def ret(value):
+    return {'Return': {'__meta__': meta(), 'value': value}}
+
+
+def mutable_decl(name):
+    ret = property_decl(name)
+    ret['PropertyDecl']['mutability'] = 'mut'
+    return ret
+
+
+CASES = {
+    'global': [
+        mutable_decl('g'),
+        function_decl('f', 'x', [
+            assignment('g', identifier('x', INT)),
+            function_decl('h', 'y', [ret(identifier('g', INT))]),
+            ret(call('h', identifier('x', INT), 'y'))]),
+        assignment('g', literal(1)),
+        call('f', identifier('g', INT))],
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('tango', help='path to the tango binary')
+    parser.add_argument('--opt-level', default='2', choices=['0', '1', '2', '3', 's'])
+    args = parser.parse_args()
+
+    failures = 0
+    with tempfile.TemporaryDirectory() as workdir:
+        for index, (name, statements) in enumerate(sorted(CASES.items())):
+            source = os.path.join(workdir, 'case%d.ast' % index)
+            with open(source, 'w') as f:
+                json.dump({'ModuleDecl': {'__meta__': {}, 'name': 'main',
+                                          'body': block(statements)}}, f)
+
+            for mode in ['lifted', 'stack', 'heap']:
+                process = subprocess.run(
+                    [args.tango, '--run', '-O%s' % args.opt_level] + MODES[mode] + [source],
+                    stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+                if process.returncode == 0:
+                    print('PASS %s (%s)' % (name, mode))
+                else:
+                    print('FAIL %s (%s): exit status %d: %s' % (
+                        name, mode, process.returncode, process.stderr.strip()))
+                    failures += 1
+
+    return 1 if failures > 0 else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())